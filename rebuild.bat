@@ -16,19 +16,51 @@ echo Step 2: Compiling neural_network.cpp...
 %COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\neural_network.cpp
 if errorlevel 1 goto error
 
-echo Step 3: Compiling image_processor.cpp...
+echo Step 3: Compiling model_file.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\model_file.cpp
+if errorlevel 1 goto error
+
+echo Step 4: Compiling dataset.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\dataset.cpp
+if errorlevel 1 goto error
+
+echo Step 5: Compiling idx_dataset.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\idx_dataset.cpp
+if errorlevel 1 goto error
+
+echo Step 6: Compiling batch_pipeline.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\batch_pipeline.cpp
+if errorlevel 1 goto error
+
+echo Step 7: Compiling image_processor.cpp...
 %COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\image_processor.cpp
 if errorlevel 1 goto error
 
-echo Step 4: Compiling drawing_interface.cpp...
+echo Step 8: Compiling drawing_interface.cpp...
 %COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\drawing_interface.cpp
 if errorlevel 1 goto error
 
-echo Step 5: Linking...
-%COMPILER% main.obj neural_network.obj image_processor.obj drawing_interface.obj /link /LIBPATH:"%OPENCV%\build\x64\vc16\lib" opencv_world4110.lib /OUT:digit_recognition.exe
+echo Step 9: Compiling metrics.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\metrics.cpp
+if errorlevel 1 goto error
+
+echo Step 10: Compiling model_snapshots.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\model_snapshots.cpp
+if errorlevel 1 goto error
+
+echo Step 11: Compiling evaluator.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\evaluator.cpp
+if errorlevel 1 goto error
+
+echo Step 12: Compiling checkpoint.cpp...
+%COMPILER% /EHsc /I"%OPENCV%\build\include" /Isrc /c src\checkpoint.cpp
+if errorlevel 1 goto error
+
+echo Step 13: Linking...
+%COMPILER% main.obj neural_network.obj model_file.obj dataset.obj idx_dataset.obj batch_pipeline.obj image_processor.obj drawing_interface.obj metrics.obj model_snapshots.obj evaluator.obj checkpoint.obj /link /LIBPATH:"%OPENCV%\build\x64\vc16\lib" opencv_world4110.lib /OUT:digit_recognition.exe
 if errorlevel 1 goto error
 
-echo Step 6: Copying DLL...
+echo Step 14: Copying DLL...
 copy "%OPENCV%\build\x64\vc16\bin\opencv_world4110.dll" .
 
 echo.
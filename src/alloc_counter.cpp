@@ -0,0 +1,91 @@
+#include "alloc_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <opencv2/opencv.hpp>
+
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<uint64_t> allocation_bytes(0);
+
+static void count_allocation(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// Обертка над стандартным аллокатором cv::Mat. Освобождение идет
+// через аллокатор, записанный в UMatData, т.е. напрямую в исходный.
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+    explicit CountingMatAllocator(cv::MatAllocator* base) : base(base) {}
+    
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage) const CV_OVERRIDE {
+        cv::UMatData* u = base->allocate(dims, sizes, type, data, step, flags, usage);
+        if (u && !data) {
+            count_allocation(u->size);
+        }
+        return u;
+    }
+    
+    bool allocate(cv::UMatData* u, cv::AccessFlag flags, cv::UMatUsageFlags usage) const CV_OVERRIDE {
+        return base->allocate(u, flags, usage);
+    }
+    
+    void deallocate(cv::UMatData* u) const CV_OVERRIDE {
+        base->deallocate(u);
+    }
+
+private:
+    cv::MatAllocator* base;
+};
+
+void AllocationCounter::install() {
+    static CountingMatAllocator allocator(cv::Mat::getStdAllocator());
+    cv::Mat::setDefaultAllocator(&allocator);
+}
+
+AllocationCounter::Snapshot AllocationCounter::snapshot() {
+    Snapshot s;
+    s.count = allocation_count.load(std::memory_order_relaxed);
+    s.bytes = allocation_bytes.load(std::memory_order_relaxed);
+    return s;
+}
+
+// Замена глобальных operator new/delete
+void* operator new(size_t size) {
+    count_allocation(size);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    count_allocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
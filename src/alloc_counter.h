@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// Счетчик выделений памяти для бенчмарков и метрик.
+// Учитывает глобальный operator new (замена в alloc_counter.cpp действует
+// во всей программе, в которую он слинкован) и буферы cv::Mat - их OpenCV
+// выделяет мимо operator new, поэтому install() ставит считающий аллокатор.
+class AllocationCounter {
+public:
+    struct Snapshot {
+        uint64_t count;
+        uint64_t bytes;
+    };
+    
+    // Подключает счетчик к аллокатору cv::Mat; вызывать до создания матриц
+    static void install();
+    
+    // Сумма с начала программы; разность двух снимков - выделения за участок
+    static Snapshot snapshot();
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "batch_pipeline.h"
+#include <algorithm>
+#include <chrono>
+
+static double elapsed_ms(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+BatchPipeline::BatchPipeline(const Producer& producer, int workers, int queue_depth, size_t first)
+    : producer(producer), ring(std::max(1, queue_depth)), worker_count(std::max(1, workers)), first_index(first), 
+      next_claim(first), next_consume(first),
+      produced(0), stopping(false), producer_stall_ms(0.0), consumer_stall_ms(0.0) {
+    
+    for (size_t i = 0; i < ring.size(); ++i) {
+        ring[i].ready = false;
+    }
+    
+    for (int i = 0; i < worker_count; ++i) {
+        threads.push_back(std::thread(&BatchPipeline::worker, this));
+    }
+}
+
+BatchPipeline::~BatchPipeline() {
+    stop();
+}
+
+void BatchPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slot_free.notify_all();
+    slot_ready.notify_all();
+    
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (threads[i].joinable()) {
+            threads[i].join();
+        }
+    }
+    threads.clear();
+}
+
+void BatchPipeline::worker() {
+    while (true) {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            
+            // Батч k занимает ячейку k % depth, пока его не заберут
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            slot_free.wait(lock, [this] {
+                return stopping || next_claim < next_consume + ring.size();
+            });
+            producer_stall_ms += elapsed_ms(start);
+            
+            if (stopping) {
+                return;
+            }
+            index = next_claim++;
+        }
+        
+        Dataset batch;
+        std::exception_ptr failure;
+        try {
+            batch = producer(index);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Slot& slot = ring[index % ring.size()];
+            slot.batch = batch;
+            slot.ready = true;
+            produced++;
+            if (failure && !error) {
+                error = failure;
+            }
+        }
+        slot_ready.notify_all();
+    }
+}
+
+Dataset BatchPipeline::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Slot& slot = ring[next_consume % ring.size()];
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    slot_ready.wait(lock, [this, &slot] { return slot.ready || error || stopping; });
+    consumer_stall_ms += elapsed_ms(start);
+    
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (!slot.ready) {
+        return Dataset();
+    }
+    
+    Dataset batch = slot.batch;
+    slot.batch = Dataset();
+    slot.ready = false;
+    next_consume++;
+    
+    lock.unlock();
+    slot_free.notify_all();
+    return batch;
+}
+
+BatchPipeline::Stats BatchPipeline::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    Stats s;
+    s.workers = worker_count;
+    s.queue_depth = static_cast<int>(ring.size());
+    s.ready = 0;
+    for (size_t i = 0; i < ring.size(); ++i) {
+        if (ring[i].ready) {
+            s.ready++;
+        }
+    }
+    s.produced = produced;
+    s.consumed = next_consume - first_index;
+    s.producer_stall_ms = producer_stall_ms;
+    s.consumer_stall_ms = consumer_stall_ms;
+    return s;
+}
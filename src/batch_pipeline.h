@@ -0,0 +1,73 @@
+#ifndef BATCH_PIPELINE_H
+#define BATCH_PIPELINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dataset.h"
+
+// Фоновая подготовка батчей: рабочие потоки генерируют/аугментируют
+// следующие батчи в кольцевой буфер ограниченной глубины, пока
+// обучение обрабатывает текущий. Батч с номером k всегда строится
+// вызовом producer(k) и выдается строго по порядку номеров, поэтому
+// последовательность батчей не зависит от числа потоков.
+class BatchPipeline {
+public:
+    typedef std::function<Dataset(size_t index)> Producer;
+    
+    struct Stats {
+        int workers;
+        int queue_depth;
+        size_t ready;               // готовых батчей в буфере сейчас
+        size_t produced;
+        size_t consumed;
+        double producer_stall_ms;   // ожидание свободного места (сумма по потокам)
+        double consumer_stall_ms;   // ожидание готового батча в next()
+    };
+    
+    // first - номер первого батча (продолжение прерванного обучения)
+    BatchPipeline(const Producer& producer, int workers = 2, int queue_depth = 4, size_t first = 0);
+    ~BatchPipeline();
+    
+    // Следующий батч; блокирует, пока он не готов.
+    // Исключение из producer пробрасывается сюда.
+    Dataset next();
+    
+    Stats stats() const;
+    void stop();
+
+private:
+    struct Slot {
+        Dataset batch;
+        bool ready;
+    };
+    
+    Producer producer;
+    std::vector<Slot> ring;
+    std::vector<std::thread> threads;
+    int worker_count;       // задается один раз: stop() очищает threads без мьютекса
+    
+    mutable std::mutex mutex;
+    std::condition_variable slot_free;
+    std::condition_variable slot_ready;
+    
+    size_t first_index;
+    size_t next_claim;
+    size_t next_consume;
+    size_t produced;
+    bool stopping;
+    std::exception_ptr error;
+    double producer_stall_ms;
+    double consumer_stall_ms;
+    
+    void worker();
+    
+    BatchPipeline(const BatchPipeline&);
+    BatchPipeline& operator=(const BatchPipeline&);
+};
+
+#endif
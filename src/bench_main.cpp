@@ -0,0 +1,234 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "image_processor.h"
+#include "dataset.h"
+#include "alloc_counter.h"
+#include "fixed_network.h"
+
+typedef FixedNetwork<784, 128, 64, 10> DigitNetwork;
+
+// Результат одного замера: величины на одну операцию (пример, изображение, файл)
+struct BenchResult {
+    std::string name;
+    int batch;
+    uint64_t iterations;
+    double ns_per_op;
+    double ops_per_sec;
+    double allocs_per_op;
+    double alloc_bytes_per_op;
+};
+
+// Повторяет fn, пока не наберется min_ms (и не меньше 3 раз) после прогрева.
+// ops - число операций за один вызов fn.
+template <typename Fn>
+static BenchResult run_bench(const std::string& name, int batch, int ops, double min_ms, Fn fn) {
+    fn();
+    
+    AllocationCounter::Snapshot before = AllocationCounter::snapshot();
+    int64_t start = cv::getTickCount();
+    uint64_t iterations = 0;
+    double elapsed_ms = 0.0;
+    
+    while (iterations < 3 || elapsed_ms < min_ms) {
+        fn();
+        iterations++;
+        elapsed_ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+    }
+    
+    AllocationCounter::Snapshot after = AllocationCounter::snapshot();
+    double total_ops = static_cast<double>(iterations) * ops;
+    
+    BenchResult r;
+    r.name = name;
+    r.batch = batch;
+    r.iterations = iterations;
+    r.ns_per_op = elapsed_ms * 1e6 / total_ops;
+    r.ops_per_sec = total_ops * 1000.0 / elapsed_ms;
+    r.allocs_per_op = (after.count - before.count) / total_ops;
+    r.alloc_bytes_per_op = (after.bytes - before.bytes) / total_ops;
+    
+    std::cerr << name << " (batch " << batch << "): " << r.ns_per_op << " ns/op, " 
+              << r.allocs_per_op << " allocs/op" << std::endl;
+    return r;
+}
+
+static std::string to_json(const std::vector<BenchResult>& results, int threads) {
+    std::ostringstream out;
+    out.precision(6);
+    out << "{\n"
+        << "  \"opencv\": \"" << CV_VERSION << "\",\n"
+        << "  \"threads\": " << threads << ",\n"
+        << "  \"results\": [\n";
+    
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"batch\": " << r.batch
+            << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.ns_per_op
+            << ", \"ops_per_sec\": " << r.ops_per_sec
+            << ", \"allocs_per_op\": " << r.allocs_per_op
+            << ", \"alloc_bytes_per_op\": " << r.alloc_bytes_per_op << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+// Бенчмарки обучения, распознавания, предобработки и сохранения модели.
+// Использование: digit_bench [--out results.json] [--min-ms N] [--threads N]
+// JSON печатается в stdout (и в файл, если задан), ход замеров - в stderr.
+// Корректность быстрых путей проверяет digit_tests.
+int main(int argc, char** argv) {
+    AllocationCounter::install();
+    
+    std::string out_path;
+    double min_ms = 500.0;
+    int threads = cv::getNumberOfCPUs();
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (arg == "--min-ms" && i + 1 < argc) {
+            min_ms = std::atof(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    
+    // Обучение и генерация печатают прогресс в stdout - глушим его,
+    // чтобы в stdout остался только JSON
+    std::ostringstream silenced;
+    std::streambuf* console = std::cout.rdbuf(silenced.rdbuf());
+    
+    std::vector<BenchResult> results;
+    
+    try {
+        NeuralNetwork nn({784, 128, 64, 10}, 0.01, CV_32F, static_cast<int>(ImageProcessor::DEFAULT_SEED));
+        nn.set_num_threads(threads);
+        
+        Dataset dataset = ImageProcessor::generate_dataset(1000, ImageProcessor::DEFAULT_SEED, CV_32F);
+        
+        const int batch_sizes[] = {1, 32, 256};
+        for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++i) {
+            int n = batch_sizes[i];
+            cv::Mat batch = dataset.samples().rowRange(0, n);
+            
+            results.push_back(run_bench("forward", n, n, min_ms, [&] { 
+                nn.forward(batch); 
+            }));
+            
+            // Буферы выделяются при прогреве
+            NeuralNetwork::Workspace workspace;
+            results.push_back(run_bench("forward_workspace", n, n, min_ms, [&] { 
+                nn.forward(batch, workspace); 
+            }));
+            
+            if (n == 1) {
+                results.push_back(run_bench("predict", n, n, min_ms, [&] { 
+                    nn.predict(batch); 
+                }));
+            } else {
+                results.push_back(run_bench("predict_batch", n, n, min_ms, [&] { 
+                    nn.predict_batch(batch); 
+                }));
+            }
+        }
+        
+        // Сеть с размерами на этапе компиляции: та же модель, один пример
+        std::unique_ptr<DigitNetwork> fixed(new DigitNetwork());
+        fixed->load(nn);
+        
+        cv::Mat single = dataset.samples().row(0);
+        results.push_back(run_bench("predict_fixed", 1, 1, min_ms, [&] {
+            fixed->predict(single);
+        }));
+        
+        // Одна эпоха на 1000 примерах, ops - число примеров
+        results.push_back(run_bench("train_epoch", 32, static_cast<int>(dataset.size()), min_ms, [&] {
+            nn.train(dataset, 1, 32);
+        }));
+        
+        // Снимок холста интерфейса: 280x280 BGR
+        cv::Mat canvas(280, 280, CV_8UC3, cv::Scalar(0, 0, 0));
+        cv::circle(canvas, cv::Point(140, 140), 80, cv::Scalar(255, 255, 255), 30);
+        results.push_back(run_bench("preprocess_image", 1, 1, min_ms, [&] {
+            ImageProcessor::preprocess_image(canvas, CV_32F);
+        }));
+        
+        // Батч из 256 изображений разного размера и числа каналов
+        std::vector<cv::Mat> raw_images;
+        for (int i = 0; i < 256; ++i) {
+            switch (i % 3) {
+                case 0: raw_images.push_back(canvas); break;
+                case 1: raw_images.push_back(cv::Mat(100, 100, CV_8UC1, cv::Scalar(0))); break;
+                case 2: raw_images.push_back(cv::Mat(28, 28, CV_8UC1, cv::Scalar(0))); break;
+            }
+        }
+        cv::Mat preprocessed;
+        results.push_back(run_bench("preprocess_batch", 256, 256, min_ms, [&] {
+            ImageProcessor::preprocess_batch(raw_images, preprocessed, CV_32F);
+        }));
+        
+        // Рисунок на пустом фоне: первый слой идет по разреженному пути
+        cv::Mat drawn = ImageProcessor::preprocess_image(canvas, CV_32F);
+        results.push_back(run_bench("predict_sparse", 1, 1, min_ms, [&] {
+            nn.predict(drawn);
+        }));
+        
+        results.push_back(run_bench("generate_test_images", 100, 100, min_ms, [&] {
+            ImageProcessor::generate_test_images(100, CV_32F);
+        }));
+        
+        const char* formats[] = {"bench_model.bin", "bench_model.xml"};
+        for (int f = 0; f < 2; ++f) {
+            std::string path = formats[f];
+            std::string ext = path.substr(path.rfind('.') + 1);
+            
+            results.push_back(run_bench("save_model_" + ext, 1, 1, min_ms, [&] {
+                nn.save_model(path);
+            }));
+            
+            NeuralNetwork loaded({784, 128, 64, 10}, 0.01, CV_32F);
+            results.push_back(run_bench("load_model_" + ext, 1, 1, min_ms, [&] {
+                loaded.load_model(path);
+            }));
+            
+            std::remove(path.c_str());
+        }
+        
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(console);
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    std::cout.rdbuf(console);
+    
+    std::string json = to_json(results, threads);
+    std::cout << json;
+    
+    if (!out_path.empty()) {
+        std::ofstream file(out_path.c_str());
+        file << json;
+        if (!file) {
+            std::cerr << "Error: cannot write " << out_path << std::endl;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
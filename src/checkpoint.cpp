@@ -0,0 +1,146 @@
+#include "checkpoint.h"
+#include "model_file.h"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static const char CHECKPOINT_MAGIC[4] = {'D', 'G', 'C', 'K'};
+
+void Checkpoint::write(const std::string& filename, const NeuralNetwork::TrainingState& state) {
+    std::vector<unsigned char> model = ModelFile::serialize(state.layer_sizes, state.learning_rate, 
+                                                            state.weights, state.biases);
+    
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.epoch = static_cast<uint32_t>(state.epoch);
+    header.rng_size = static_cast<uint32_t>(state.rng.size());
+    header.steps = state.steps;
+    header.model_offset = (sizeof(header) + state.rng.size() + ModelFile::ALIGNMENT - 1) 
+                          / ModelFile::ALIGNMENT * ModelFile::ALIGNMENT;
+    header.model_size = model.size();
+    
+    std::vector<unsigned char> buffer(header.model_offset + model.size(), 0);
+    std::memcpy(&buffer[sizeof(header)], state.rng.data(), state.rng.size());
+    std::memcpy(&buffer[header.model_offset], model.data(), model.size());
+    header.checksum = ModelFile::checksum(&buffer[sizeof(header)], buffer.size() - sizeof(header));
+    std::memcpy(&buffer[0], &header, sizeof(header));
+    
+    ModelFile::write_file(filename, buffer);
+}
+
+void Checkpoint::read(const std::string& filename, NeuralNetwork::TrainingState& state) {
+    std::shared_ptr<MappedFile> mapped = std::make_shared<MappedFile>(filename);
+    const unsigned char* data = mapped->data();
+    
+    CheckpointHeader header;
+    if (mapped->size() < sizeof(header)) {
+        throw std::runtime_error("Checkpoint is truncated: " + filename);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    
+    if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a training checkpoint: " + filename);
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version: " + filename);
+    }
+    if (header.model_offset < sizeof(header) + header.rng_size ||
+        header.model_offset > mapped->size() || 
+        mapped->size() - header.model_offset < header.model_size) {
+        throw std::runtime_error("Checkpoint is truncated: " + filename);
+    }
+    if (ModelFile::checksum(data + sizeof(header), mapped->size() - sizeof(header)) != header.checksum) {
+        throw std::runtime_error("Checkpoint checksum mismatch: " + filename);
+    }
+    
+    // Модель уже покрыта контрольной суммой точки
+    ModelData model = ModelFile::read(mapped, header.model_offset, filename);
+    
+    state.layer_sizes = model.layer_sizes;
+    state.learning_rate = model.learning_rate;
+    state.weights.resize(model.weights.size());
+    state.biases.resize(model.biases.size());
+    for (size_t i = 0; i < model.weights.size(); ++i) {
+        // Свои буферы: отображение закрывается после чтения
+        model.weights[i].copyTo(state.weights[i]);
+        model.biases[i].copyTo(state.biases[i]);
+    }
+    
+    state.epoch = static_cast<int>(header.epoch);
+    state.steps = header.steps;
+    state.rng.assign(reinterpret_cast<const char*>(data + sizeof(header)), header.rng_size);
+}
+
+Checkpointer::Checkpointer(const std::string& filename)
+    : filename(filename), has_pending(false), busy(false), stopping(false), last_written(0) {
+    thread = std::thread(&Checkpointer::writer, this);
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Checkpointer::submit(const NeuralNetwork& network) {
+    {
+        // Поток записи работает с writing, поэтому здесь только
+        // копирование в уже выделенные буферы pending
+        std::lock_guard<std::mutex> lock(mutex);
+        network.capture_state(pending);
+        has_pending = true;
+    }
+    wake.notify_one();
+}
+
+void Checkpointer::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !has_pending && !busy; });
+}
+
+int Checkpointer::written_epoch() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return last_written;
+}
+
+void Checkpointer::writer() {
+    std::unique_lock<std::mutex> lock(mutex);
+    
+    while (true) {
+        wake.wait(lock, [this] { return stopping || has_pending; });
+        if (!has_pending) {
+            break;
+        }
+        
+        // Обмен буферами без копирования; пока пишем, обучение
+        // может отправить следующую точку
+        std::swap(pending, writing);
+        has_pending = false;
+        busy = true;
+        lock.unlock();
+        
+        bool ok = true;
+        try {
+            Checkpoint::write(filename, writing);
+        } catch (const std::exception& e) {
+            // Ошибка записи не прерывает обучение, остается предыдущая точка
+            std::cerr << "Checkpoint error: " << e.what() << std::endl;
+            ok = false;
+        }
+        
+        lock.lock();
+        busy = false;
+        if (ok) {
+            last_written = writing.epoch;
+        }
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "neural_network.h"
+
+// Контрольная точка обучения (версия 1, little-endian):
+//   заголовок CheckpointHeader (64 байта)
+//   состояние генератора (rng_size байт текста)
+//   с выровненного на 64 байта смещения model_offset - модель в формате
+//   ModelFile (model_size байт)
+// checksum - FNV-1a 64 по всему, что идет после заголовка.
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t epoch;
+    uint32_t rng_size;
+    uint64_t steps;
+    uint64_t model_offset;
+    uint64_t model_size;
+    uint64_t checksum;
+    unsigned char reserved[16];
+};
+
+class Checkpoint {
+public:
+    static const uint32_t VERSION = 1;
+    
+    // Пишет во временный файл и атомарно заменяет filename:
+    // при сбое на диске остается предыдущая целая точка
+    static void write(const std::string& filename, const NeuralNetwork::TrainingState& state);
+    static void read(const std::string& filename, NeuralNetwork::TrainingState& state);
+};
+
+// Фоновая запись контрольных точек. submit() только копирует веса
+// в буфер и будит поток записи, обучение дальше не ждет диска.
+// Если предыдущая точка еще пишется, в очереди остается только
+// самая новая.
+class Checkpointer {
+public:
+    explicit Checkpointer(const std::string& filename);
+    
+    // Дописывает последнюю отправленную точку
+    ~Checkpointer();
+    
+    void submit(const NeuralNetwork& network);
+    
+    // Ждет, пока все отправленные точки будут записаны
+    void flush();
+    
+    const std::string& path() const { return filename; }
+    
+    // Номер эпохи последней записанной точки (0 - еще ни одной)
+    int written_epoch() const;
+
+private:
+    std::string filename;
+    
+    // pending заполняет обучение, writing - поток записи
+    NeuralNetwork::TrainingState pending, writing;
+    bool has_pending;
+    bool busy;
+    bool stopping;
+    int last_written;
+    
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::thread thread;
+    
+    void writer();
+    
+    Checkpointer(const Checkpointer&);
+    Checkpointer& operator=(const Checkpointer&);
+};
+
+#endif
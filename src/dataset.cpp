@@ -0,0 +1,104 @@
+#include "dataset.h"
+#include <algorithm>
+
+// Батч, оставшийся представлением строк набора, нельзя перезаписывать
+static void detach_view(cv::Mat& batch, const cv::Mat& samples) {
+    if (!batch.empty() && batch.datastart == samples.datastart) {
+        batch.release();
+    }
+}
+
+Dataset::Dataset() : scale(1.0) {
+}
+
+Dataset::Dataset(const cv::Mat& samples, const cv::Mat& labels, double scale,
+                 const std::shared_ptr<void>& owner)
+    : data(samples), label_data(labels), scale(scale), owner(owner) {
+    
+    CV_Assert(samples.channels() == 1 && labels.type() == CV_8U);
+    CV_Assert(labels.rows == samples.rows && labels.cols == 1);
+}
+
+Dataset Dataset::from_vectors(const std::vector<cv::Mat>& images,
+                              const std::vector<cv::Mat>& targets, int depth) {
+    size_t count = std::min(images.size(), targets.size());
+    if (count == 0) {
+        return Dataset();
+    }
+    
+    int size = static_cast<int>(images.front().total());
+    cv::Mat samples(static_cast<int>(count), size, depth);
+    cv::Mat labels(static_cast<int>(count), 1, CV_8U);
+    
+    for (size_t i = 0; i < count; ++i) {
+        int r = static_cast<int>(i);
+        CV_Assert(static_cast<int>(images[i].total()) == size);
+        images[i].reshape(1, 1).convertTo(samples.row(r), depth);
+        
+        cv::Point max_loc;
+        cv::minMaxLoc(targets[i].reshape(1, 1), nullptr, nullptr, nullptr, &max_loc);
+        labels.at<uchar>(r, 0) = static_cast<uchar>(max_loc.x);
+    }
+    
+    return Dataset(samples, labels);
+}
+
+Dataset Dataset::rows(size_t begin, size_t end) const {
+    int first = static_cast<int>(begin);
+    int last = static_cast<int>(end);
+    return Dataset(data.rowRange(first, last), label_data.rowRange(first, last), scale, owner);
+}
+
+cv::Mat Dataset::inputs(size_t begin, size_t end, int depth) const {
+    cv::Mat view = data.rowRange(static_cast<int>(begin), static_cast<int>(end));
+    if (view.depth() == depth && scale == 1.0) {
+        return view;
+    }
+    
+    cv::Mat converted;
+    view.convertTo(converted, depth, scale);
+    return converted;
+}
+
+void Dataset::batch(size_t begin, size_t end, int depth, int classes,
+                    cv::Mat& inputs, cv::Mat& targets) const {
+    cv::Mat view = data.rowRange(static_cast<int>(begin), static_cast<int>(end));
+    detach_view(inputs, data);
+    
+    if (view.depth() == depth && scale == 1.0) {
+        inputs = view;
+    } else {
+        view.convertTo(inputs, depth, scale);
+    }
+    
+    int n = static_cast<int>(end - begin);
+    targets.create(n, classes, depth);
+    targets.setTo(0.0);
+    
+    for (int r = 0; r < n; ++r) {
+        int digit = label(begin + r);
+        if (digit < classes) {
+            targets(cv::Rect(digit, r, 1, 1)).setTo(1.0);
+        }
+    }
+}
+
+void Dataset::batch(const std::vector<size_t>& order, size_t begin, size_t end, int depth,
+                    int classes, cv::Mat& inputs, cv::Mat& targets) const {
+    int n = static_cast<int>(end - begin);
+    
+    detach_view(inputs, data);
+    inputs.create(n, data.cols, depth);
+    targets.create(n, classes, depth);
+    targets.setTo(0.0);
+    
+    for (int r = 0; r < n; ++r) {
+        int index = static_cast<int>(order[begin + r]);
+        data.row(index).convertTo(inputs.row(r), depth, scale);
+        
+        int digit = label_data.at<uchar>(index, 0);
+        if (digit < classes) {
+            targets(cv::Rect(digit, r, 1, 1)).setTo(1.0);
+        }
+    }
+}
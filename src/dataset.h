@@ -0,0 +1,58 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Набор примеров: одна непрерывная матрица [N x D] (по примеру в строке)
+// и компактный массив меток [N x 1] CV_8U. Батчи - диапазоны строк
+// или выборки по индексам, без отдельного cv::Mat на каждый пример.
+// Пиксели могут храниться в uint8 (scale = 1/255) и переводятся
+// в точность сети только для строк текущего батча.
+class Dataset {
+public:
+    Dataset();
+    
+    // owner держит живой память, на которую ссылаются samples/labels
+    // (например, отображенный файл)
+    Dataset(const cv::Mat& samples, const cv::Mat& labels, double scale = 1.0,
+            const std::shared_ptr<void>& owner = std::shared_ptr<void>());
+    
+    // Из векторов [1 x D] изображений и one-hot векторов целей
+    static Dataset from_vectors(const std::vector<cv::Mat>& images,
+                                const std::vector<cv::Mat>& targets, int depth = CV_32F);
+    
+    size_t size() const { return static_cast<size_t>(data.rows); }
+    bool empty() const { return data.empty(); }
+    int sample_size() const { return data.cols; }
+    double get_scale() const { return scale; }
+    
+    const cv::Mat& samples() const { return data; }
+    const cv::Mat& labels() const { return label_data; }
+    int label(size_t index) const { return label_data.at<uchar>(static_cast<int>(index), 0); }
+    
+    // Строки [begin, end) как представление того же набора
+    Dataset rows(size_t begin, size_t end) const;
+    
+    // Входы [begin, end) в точности depth; без копирования, если
+    // тип совпадает и масштаб равен 1
+    cv::Mat inputs(size_t begin, size_t end, int depth) const;
+    
+    // Батч из строк [begin, end), targets - one-hot [n x classes]
+    void batch(size_t begin, size_t end, int depth, int classes,
+               cv::Mat& inputs, cv::Mat& targets) const;
+    
+    // Батч из order[begin, end) - перемешивание по индексам
+    void batch(const std::vector<size_t>& order, size_t begin, size_t end, int depth,
+               int classes, cv::Mat& inputs, cv::Mat& targets) const;
+
+private:
+    cv::Mat data;
+    cv::Mat label_data;
+    double scale;
+    std::shared_ptr<void> owner;
+};
+
+#endif
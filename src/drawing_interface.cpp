@@ -1,19 +1,81 @@
 #include "drawing_interface.h"
 #include <iostream>
+#include <algorithm>
 
-DrawingInterface::DrawingInterface(NeuralNetwork& nn) 
-    : neuralNetwork(nn), drawing(false) {
+// Положение холста в окне
+static const cv::Rect CANVAS_ROI(160, 60, 280, 280);
+
+// Сторона входа сети и запас вокруг штриха (радиус кисти + 1)
+static const int INPUT_SIDE = 28;
+static const int BRUSH_MARGIN = 16;
+static const char* WINDOW_NAME = "Draw Digit - Press Q to quit";
+
+DrawingInterface::DrawingInterface(const ModelSnapshots& model) 
+    : drawing(false), dirty(true), model(model), modelVersion(0), stopping(false), 
+      prediction(-1), predictionChanged(false) {
     initializeCanvas();
+    renderBackground();
+}
+
+DrawingInterface::~DrawingInterface() {
+    stopWorker();
 }
 
 void DrawingInterface::initializeCanvas() {
-    canvas = cv::Mat::zeros(280, 280, CV_8UC1);
+    canvas = cv::Mat::zeros(CANVAS_ROI.height, CANVAS_ROI.width, CV_8UC1);
+    
+    // Пустой холст после инверсии - все единицы
+    input.create(1, INPUT_SIDE * INPUT_SIDE, model.acquire()->get_depth());
+    input.setTo(1.0);
+    
     drawing = false;
+    dirty = true;
+}
+
+void DrawingInterface::updateInput(const cv::Rect& area) {
+    // Пересчитываем только блоки холста, которые задел штрих
+    cv::Rect region = area & cv::Rect(0, 0, canvas.cols, canvas.rows);
+    if (region.empty()) {
+        return;
+    }
+    
+    const int block = canvas.cols / INPUT_SIDE;
+    const double norm = 1.0 / (block * block * 255.0);
+    
+    int first_col = region.x / block;
+    int last_col = std::min(INPUT_SIDE - 1, (region.x + region.width - 1) / block);
+    int first_row = region.y / block;
+    int last_row = std::min(INPUT_SIDE - 1, (region.y + region.height - 1) / block);
+    
+    for (int by = first_row; by <= last_row; ++by) {
+        for (int bx = first_col; bx <= last_col; ++bx) {
+            int sum = 0;
+            for (int y = by * block; y < (by + 1) * block; ++y) {
+                const uchar* row = canvas.ptr<uchar>(y) + bx * block;
+                for (int x = 0; x < block; ++x) {
+                    sum += row[x];
+                }
+            }
+            
+            // Среднее по блоку, инвертированное и нормализованное
+            double value = 1.0 - sum * norm;
+            int index = by * INPUT_SIDE + bx;
+            if (input.depth() == CV_32F) {
+                input.at<float>(0, index) = static_cast<float>(value);
+            } else {
+                input.at<double>(0, index) = value;
+            }
+        }
+    }
 }
 
 void DrawingInterface::onMouse(int event, int x, int y, int flags, void* param) {
     DrawingInterface* interface = static_cast<DrawingInterface*>(param);
     
+    // Координаты окна -> координаты холста
+    x -= CANVAS_ROI.x;
+    y -= CANVAS_ROI.y;
+    
     if (x < 0 || y < 0 || x >= interface->canvas.cols || y >= interface->canvas.rows) {
         return;
     }
@@ -23,12 +85,21 @@ void DrawingInterface::onMouse(int event, int x, int y, int flags, void* param)
             interface->drawing = true;
             interface->lastPoint = cv::Point(x, y);
             cv::circle(interface->canvas, interface->lastPoint, 15, cv::Scalar(255), -1);
+            interface->updateInput(cv::Rect(x - BRUSH_MARGIN, y - BRUSH_MARGIN, 
+                                            2 * BRUSH_MARGIN + 1, 2 * BRUSH_MARGIN + 1));
+            interface->dirty = true;
             break;
             
         case cv::EVENT_MOUSEMOVE:
             if (interface->drawing) {
                 cv::line(interface->canvas, interface->lastPoint, cv::Point(x, y), cv::Scalar(255), 30);
+                interface->updateInput(cv::Rect(
+                    cv::Point(std::min(x, interface->lastPoint.x) - BRUSH_MARGIN, 
+                              std::min(y, interface->lastPoint.y) - BRUSH_MARGIN),
+                    cv::Point(std::max(x, interface->lastPoint.x) + BRUSH_MARGIN + 1, 
+                              std::max(y, interface->lastPoint.y) + BRUSH_MARGIN + 1)));
                 interface->lastPoint = cv::Point(x, y);
+                interface->dirty = true;
             }
             break;
             
@@ -37,7 +108,7 @@ void DrawingInterface::onMouse(int event, int x, int y, int flags, void* param)
             break;
             
         case cv::EVENT_RBUTTONDOWN:
-            interface->canvas = cv::Mat::zeros(280, 280, CV_8UC1);
+            interface->initializeCanvas();
             break;
     }
 }
@@ -48,33 +119,94 @@ void DrawingInterface::mouseCallback(int event, int x, int y, int flags, void* p
 }
 
 cv::Mat DrawingInterface::preprocessDrawing() {
-    try {
-        // Масштабируем до 28x28
-        cv::Mat resized;
-        cv::resize(canvas, resized, cv::Size(28, 28));
-        
-        // Инвертируем: черный фон, белая цифра -> белый фон, черная цифра
-        cv::Mat inverted;
-        cv::bitwise_not(resized, inverted);
-        
-        // Конвертируем в double и нормализуем
-        cv::Mat normalized;
-        inverted.convertTo(normalized, CV_64F, 1.0 / 255.0);
-        
-        // Выравниваем в вектор [1 x 784]
-        return normalized.reshape(1, 1);
+    // Вход [1 x 784] поддерживается инкрементально в updateInput();
+    // копия нужна, т.к. распознавание идет в другом потоке
+    return input.clone();
+}
+
+void DrawingInterface::renderBackground() {
+    background = cv::Mat::zeros(500, 600, CV_8UC3);
+    
+    // Рамка вокруг холста
+    cv::Rect frame(CANVAS_ROI.x - 2, CANVAS_ROI.y - 2, CANVAS_ROI.width + 4, CANVAS_ROI.height + 4);
+    cv::rectangle(background, frame, cv::Scalar(0, 255, 0), 2);
+    
+    // Инструкции
+    cv::putText(background, "Instructions:", cv::Point(50, 380), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 255, 255), 2);
+    cv::putText(background, "Left click: Draw", cv::Point(50, 410), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
+    cv::putText(background, "Right click: Clear", cv::Point(50, 430), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
+    cv::putText(background, "Press 'c': Clear canvas", cv::Point(50, 450), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
+    cv::putText(background, "Press 'q': Quit", cv::Point(50, 470), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
+}
+
+void DrawingInterface::render() {
+    background.copyTo(display);
+    
+    // Копируем холст в центр
+    cv::Mat target = display(CANVAS_ROI);
+    cv::cvtColor(canvas, target, cv::COLOR_GRAY2BGR);
+    
+    // Отображаем предсказание КРУПНЫМ шрифтом
+    std::string predictionText = "Prediction: " + std::to_string(prediction.load());
+    cv::putText(display, predictionText, cv::Point(50, 40), 
+               cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(0, 255, 255), 3);
+    
+    std::string versionText = "Model v" + std::to_string(modelVersion);
+    cv::putText(display, versionText, cv::Point(460, 470), 
+               cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(150, 150, 150), 1);
+    
+    cv::imshow(WINDOW_NAME, display);
+}
+
+void DrawingInterface::submit(const cv::Mat& input) {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending = input;
+    }
+    pendingReady.notify_one();
+}
+
+void DrawingInterface::recognitionLoop() {
+    while (true) {
+        cv::Mat input;
+        {
+            std::unique_lock<std::mutex> lock(pendingMutex);
+            pendingReady.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (stopping) {
+                return;
+            }
+            input = pending;
+            pending.release();
+        }
         
-    } catch (const cv::Exception& e) {
-        std::cerr << "Preprocessing error: " << e.what() << std::endl;
-        return cv::Mat::zeros(1, 784, CV_64F);
+        ModelSnapshots::Reader snapshot = model.acquire();
+        prediction = snapshot->predict(input);
+        predictionChanged = true;
+    }
+}
+
+void DrawingInterface::stopWorker() {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    pendingReady.notify_one();
+    
+    if (worker.joinable()) {
+        worker.join();
     }
 }
 
 void DrawingInterface::run() {
     // Создаем окно побольше
-    cv::namedWindow("Draw Digit - Press Q to quit", cv::WINDOW_NORMAL);
-    cv::resizeWindow("Draw Digit - Press Q to quit", 600, 500);
-    cv::setMouseCallback("Draw Digit - Press Q to quit", mouseCallback, this);
+    cv::namedWindow(WINDOW_NAME, cv::WINDOW_NORMAL);
+    cv::resizeWindow(WINDOW_NAME, 600, 500);
+    cv::setMouseCallback(WINDOW_NAME, mouseCallback, this);
 
     std::cout << "=== Drawing Interface ===" << std::endl;
     std::cout << "Left click: Draw" << std::endl;
@@ -82,50 +214,43 @@ void DrawingInterface::run() {
     std::cout << "Press 'c': Clear" << std::endl;
     std::cout << "Press 'q': Quit" << std::endl;
 
+    stopping = false;
+    worker = std::thread(&DrawingInterface::recognitionLoop, this);
+    render();
+
     while (true) {
-        // Создаем большое изображение для отображения
-        cv::Mat display = cv::Mat::zeros(500, 600, CV_8UC3);
-        
-        // Копируем холст в центр
-        cv::Mat colorCanvas;
-        cv::cvtColor(canvas, colorCanvas, cv::COLOR_GRAY2BGR);
-        cv::Rect roi(160, 60, 280, 280);
-        colorCanvas.copyTo(display(roi));
+        bool redraw = false;
         
-        // Добавляем рамку
-        cv::rectangle(display, roi, cv::Scalar(0, 255, 0), 2);
-        
-        // Распознаем
-        cv::Mat processed = preprocessDrawing();
-        int prediction = -1;
-        if (!processed.empty()) {
-            prediction = neuralNetwork.predict(processed);
+        // Новая версия модели - тот же рисунок распознается заново
+        if (model.version() != modelVersion) {
+            modelVersion = model.version();
+            dirty = true;
         }
         
-        // Отображаем предсказание КРУПНЫМ шрифтом
-        std::string predictionText = "Prediction: " + std::to_string(prediction);
-        cv::putText(display, predictionText, cv::Point(50, 40), 
-                   cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(0, 255, 255), 3);
+        // Распознаем только изменившийся холст, в фоне
+        if (dirty) {
+            dirty = false;
+            cv::Mat processed = preprocessDrawing();
+            if (!processed.empty()) {
+                submit(processed);
+            }
+            redraw = true;
+        }
         
-        // Отображаем инструкции
-        cv::putText(display, "Instructions:", cv::Point(50, 380), 
-                   cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 255, 255), 2);
-        cv::putText(display, "Left click: Draw", cv::Point(50, 410), 
-                   cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
-        cv::putText(display, "Right click: Clear", cv::Point(50, 430), 
-                   cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
-        cv::putText(display, "Press 'c': Clear canvas", cv::Point(50, 450), 
-                   cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
-        cv::putText(display, "Press 'q': Quit", cv::Point(50, 470), 
-                   cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(200, 200, 200), 1);
+        if (predictionChanged.exchange(false)) {
+            redraw = true;
+        }
         
-        cv::imshow("Draw Digit - Press Q to quit", display);
+        if (redraw) {
+            render();
+        }
         
         int key = cv::waitKey(30);
         
         if (key == 'q' || key == 27) break;
-        if (key == 'c') canvas = cv::Mat::zeros(280, 280, CV_8UC1);
+        if (key == 'c') initializeCanvas();
     }
     
+    stopWorker();
     cv::destroyAllWindows();
-}
\ No newline at end of file
+}
@@ -1,19 +1,41 @@
 #ifndef DRAWING_INTERFACE_H
 #define DRAWING_INTERFACE_H
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <opencv2/opencv.hpp>
 #include "neural_network.h"
+#include "model_snapshots.h"
 
 class DrawingInterface {
 private:
     cv::Mat canvas;
+    cv::Mat input;          // Вход сети 28x28 [1 x 784], обновляется по штрихам
     cv::Mat display;
+    cv::Mat background;     // Статичная часть окна, рисуется один раз
     bool drawing;
+    bool dirty;             // Холст изменился с последнего распознавания
     cv::Point lastPoint;
-    NeuralNetwork& neuralNetwork;
+    
+    // Сеть может дообучаться в фоне - распознаем последним опубликованным снимком
+    const ModelSnapshots& model;
+    uint64_t modelVersion;  // Версия модели последнего отправленного кадра
+    
+    // Распознавание в фоновом потоке: ждет только самый свежий кадр,
+    // более старые необработанные кадры отбрасываются
+    std::thread worker;
+    std::mutex pendingMutex;
+    std::condition_variable pendingReady;
+    cv::Mat pending;
+    bool stopping;
+    std::atomic<int> prediction;
+    std::atomic<bool> predictionChanged;
 
 public:
-    DrawingInterface(NeuralNetwork& nn);
+    DrawingInterface(const ModelSnapshots& model);
+    ~DrawingInterface();
     void run();
     
 private:
@@ -21,7 +43,14 @@ private:
     void drawCircle(cv::Point center);
     void onMouse(int event, int x, int y, int flags, void* param);
     cv::Mat preprocessDrawing();
+    void updateInput(const cv::Rect& area);
     static void mouseCallback(int event, int x, int y, int flags, void* param);
+    
+    void renderBackground();
+    void render();
+    void submit(const cv::Mat& input);
+    void recognitionLoop();
+    void stopWorker();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,157 @@
+#include "evaluator.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t k = static_cast<size_t>(q * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+// Входит ли истинный класс в k самых вероятных ответов
+template <typename T>
+static bool in_top_k(const cv::Mat& probabilities, int row, int actual, int k) {
+    const T* p = probabilities.ptr<T>(row);
+    int higher = 0;
+    for (int c = 0; c < probabilities.cols; ++c) {
+        if (p[c] > p[actual]) {
+            higher++;
+        }
+    }
+    return higher < k;
+}
+
+Evaluator::Report Evaluator::evaluate(const NeuralNetwork& network, const Dataset& dataset, 
+                                      const Options& options) {
+    CV_Assert(dataset.sample_size() == network.get_layer_sizes().front());
+    
+    const int classes = network.get_layer_sizes().back();
+    const size_t count = dataset.size();
+    const int batch_size = std::max(1, options.batch_size);
+    const int batches = static_cast<int>((count + batch_size - 1) / batch_size);
+    
+    // Каждый батч пишет только в свои элементы
+    std::vector<int> predicted(count, -1);
+    std::vector<unsigned char> top_hit(count, 0);
+    std::vector<double> latency(batches, 0.0);
+    
+    int64_t start = cv::getTickCount();
+    
+    cv::parallel_for_(cv::Range(0, batches), [&](const cv::Range& range) {
+        for (int b = range.start; b < range.end; ++b) {
+            size_t begin = static_cast<size_t>(b) * batch_size;
+            size_t end = std::min(count, begin + batch_size);
+            
+            int64_t batch_start = cv::getTickCount();
+            cv::Mat probabilities;
+            std::vector<int> labels = network.predict_batch(
+                dataset.inputs(begin, end, network.get_depth()), &probabilities);
+            latency[b] = (cv::getTickCount() - batch_start) * 1000.0 / cv::getTickFrequency();
+            
+            for (size_t i = begin; i < end; ++i) {
+                int row = static_cast<int>(i - begin);
+                int actual = dataset.label(i);
+                predicted[i] = labels[row];
+                
+                if (actual < classes) {
+                    top_hit[i] = probabilities.depth() == CV_32F 
+                        ? in_top_k<float>(probabilities, row, actual, options.top_k)
+                        : in_top_k<double>(probabilities, row, actual, options.top_k);
+                }
+            }
+        }
+    }, batches);
+    
+    double seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+    
+    Report report;
+    report.samples = count;
+    report.correct = 0;
+    report.top_k_correct = 0;
+    report.top_k = options.top_k;
+    report.confusion = cv::Mat::zeros(classes, classes, CV_32S);
+    
+    for (size_t i = 0; i < count; ++i) {
+        int actual = dataset.label(i);
+        if (actual >= classes || predicted[i] < 0) {
+            continue;
+        }
+        report.confusion.at<int>(actual, predicted[i])++;
+        if (predicted[i] == actual) {
+            report.correct++;
+        }
+        report.top_k_correct += top_hit[i];
+    }
+    
+    report.accuracy = count ? static_cast<double>(report.correct) / count : 0.0;
+    report.top_k_accuracy = count ? static_cast<double>(report.top_k_correct) / count : 0.0;
+    report.batch_size = batch_size;
+    report.seconds = seconds;
+    report.images_per_sec = seconds > 0 ? count / seconds : 0.0;
+    report.latency_p50_ms = percentile(latency, 0.50);
+    report.latency_p90_ms = percentile(latency, 0.90);
+    report.latency_p99_ms = percentile(latency, 0.99);
+    report.latency_max_ms = latency.empty() ? 0.0 : *std::max_element(latency.begin(), latency.end());
+    
+    return report;
+}
+
+std::string Evaluator::Report::to_json() const {
+    std::ostringstream out;
+    out << "{\n"
+        << "  \"samples\": " << samples << ",\n"
+        << "  \"accuracy\": " << accuracy << ",\n"
+        << "  \"top_k\": " << top_k << ",\n"
+        << "  \"top_k_accuracy\": " << top_k_accuracy << ",\n"
+        << "  \"batch_size\": " << batch_size << ",\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"images_per_sec\": " << images_per_sec << ",\n"
+        << "  \"batch_latency_ms\": {\"p50\": " << latency_p50_ms 
+        << ", \"p90\": " << latency_p90_ms
+        << ", \"p99\": " << latency_p99_ms 
+        << ", \"max\": " << latency_max_ms << "},\n"
+        << "  \"confusion\": [\n";
+    
+    for (int r = 0; r < confusion.rows; ++r) {
+        out << "    [";
+        for (int c = 0; c < confusion.cols; ++c) {
+            out << (c ? ", " : "") << confusion.at<int>(r, c);
+        }
+        out << "]" << (r + 1 < confusion.rows ? ",\n" : "\n");
+    }
+    
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+void Evaluator::Report::save_json(const std::string& filename) const {
+    std::ofstream file(filename.c_str());
+    file << to_json();
+    if (!file) {
+        throw std::runtime_error("Cannot write " + filename);
+    }
+}
+
+void Evaluator::Report::print() const {
+    std::cout << "Evaluated " << samples << " images in " << seconds << " s (" 
+              << images_per_sec << " images/s)" << std::endl;
+    std::cout << "Accuracy: " << (accuracy * 100) << "% - Top-" << top_k << ": " 
+              << (top_k_accuracy * 100) << "%" << std::endl;
+    std::cout << "Batch latency (" << batch_size << " images): p50 " << latency_p50_ms 
+              << " ms, p99 " << latency_p99_ms << " ms, max " << latency_max_ms << " ms" << std::endl;
+    
+    std::cout << "Confusion (rows - actual, columns - predicted):" << std::endl;
+    for (int r = 0; r < confusion.rows; ++r) {
+        std::cout << "  " << r << ":";
+        for (int c = 0; c < confusion.cols; ++c) {
+            std::cout << " " << confusion.at<int>(r, c);
+        }
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "dataset.h"
+
+// Проверка модели на отложенном наборе: батчи распознаются параллельно,
+// результаты сводятся в фиксированном порядке, поэтому отчет (кроме
+// времени) не зависит от числа потоков.
+class Evaluator {
+public:
+    struct Options {
+        int batch_size;
+        int top_k;
+        
+        Options() : batch_size(256), top_k(3) {}
+    };
+    
+    struct Report {
+        size_t samples;
+        size_t correct;
+        size_t top_k_correct;
+        int top_k;
+        double accuracy;
+        double top_k_accuracy;
+        
+        // [classes x classes] CV_32S: строка - истинный класс, столбец - ответ
+        cv::Mat confusion;
+        
+        int batch_size;
+        double seconds;
+        double images_per_sec;
+        
+        // Задержка одного батча, мс
+        double latency_p50_ms;
+        double latency_p90_ms;
+        double latency_p99_ms;
+        double latency_max_ms;
+        
+        std::string to_json() const;
+        void save_json(const std::string& filename) const;
+        void print() const;
+    };
+    
+    static Report evaluate(const NeuralNetwork& network, const Dataset& dataset, 
+                           const Options& options = Options());
+};
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef FIXED_NETWORK_H
+#define FIXED_NETWORK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+
+// Сеть с топологией, известной на этапе компиляции, например
+// FixedNetwork<784, 128, 64, 10>. Размеры слоев - константы, веса лежат
+// в выровненных массивах внутри объекта, циклы с постоянными границами
+// разворачиваются и векторизуются компилятором. Предназначена для
+// распознавания одного изображения с минимальными накладными расходами.
+// Веса берутся из обученной NeuralNetwork (или из файла load_model).
+
+// Полносвязный слой In -> Out, веса [In x Out] построчно, как в cv::Mat
+template <int In, int Out>
+struct FixedDense {
+    alignas(64) float weights[In * Out];
+    alignas(64) float biases[Out];
+    
+    void load(const cv::Mat& w, const cv::Mat& b) {
+        CV_Assert(w.rows == In && w.cols == Out && static_cast<int>(b.total()) == Out);
+        
+        cv::Mat w_view(In, Out, CV_32F, weights);
+        cv::Mat b_view(1, Out, CV_32F, biases);
+        w.convertTo(w_view, CV_32F);
+        b.reshape(1, 1).convertTo(b_view, CV_32F);
+    }
+    
+    void apply(const float* x, float* out) const {
+        for (int j = 0; j < Out; ++j) {
+            out[j] = biases[j];
+        }
+        
+        // Четыре строки весов за проход: меньше чтений/записей out
+        int i = 0;
+        for (; i + 4 <= In; i += 4) {
+            const float x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+            const float* r0 = weights + i * Out;
+            const float* r1 = r0 + Out;
+            const float* r2 = r1 + Out;
+            const float* r3 = r2 + Out;
+            for (int j = 0; j < Out; ++j) {
+                out[j] += x0 * r0[j] + x1 * r1[j] + x2 * r2[j] + x3 * r3[j];
+            }
+        }
+        for (; i < In; ++i) {
+            const float xi = x[i];
+            const float* row = weights + i * Out;
+            for (int j = 0; j < Out; ++j) {
+                out[j] += xi * row[j];
+            }
+        }
+    }
+};
+
+// Цепочка слоев: скрытые с сигмоидой, последний возвращает логиты
+template <int... Sizes>
+struct FixedLayers;
+
+template <int In, int Out>
+struct FixedLayers<In, Out> {
+    static const int outputs = Out;
+    FixedDense<In, Out> layer;
+    
+    void load(const std::vector<cv::Mat>& w, const std::vector<cv::Mat>& b, size_t index) {
+        layer.load(w[index], b[index]);
+    }
+    
+    void apply(const float* x, float* logits) const {
+        layer.apply(x, logits);
+    }
+};
+
+template <int In, int Out, int... Rest>
+struct FixedLayers<In, Out, Rest...> {
+    static const int outputs = FixedLayers<Out, Rest...>::outputs;
+    FixedDense<In, Out> layer;
+    FixedLayers<Out, Rest...> next;
+    
+    void load(const std::vector<cv::Mat>& w, const std::vector<cv::Mat>& b, size_t index) {
+        layer.load(w[index], b[index]);
+        next.load(w, b, index + 1);
+    }
+    
+    void apply(const float* x, float* logits) const {
+        alignas(64) float hidden[Out];
+        layer.apply(x, hidden);
+        for (int j = 0; j < Out; ++j) {
+            hidden[j] = 1.0f / (1.0f + std::exp(-hidden[j]));
+        }
+        next.apply(hidden, logits);
+    }
+};
+
+template <int Input, int... Rest>
+class FixedNetwork {
+public:
+    static const int inputs = Input;
+    static const int outputs = FixedLayers<Input, Rest...>::outputs;
+    static const int layers = sizeof...(Rest);
+    
+    // Объект большой (веса внутри), создавать через new / std::unique_ptr.
+    // fastMalloc гарантирует выравнивание массивов весов.
+    static void* operator new(std::size_t size) {
+        return cv::fastMalloc(size);
+    }
+    
+    static void operator delete(void* ptr) {
+        cv::fastFree(ptr);
+    }
+    
+    // Копирует веса обученной сети; топология должна совпадать
+    void load(const NeuralNetwork& network) {
+        const std::vector<int>& sizes = network.get_layer_sizes();
+        const int expected[] = {Input, Rest...};
+        
+        CV_Assert(sizes.size() == sizeof(expected) / sizeof(expected[0]));
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            CV_Assert(sizes[i] == expected[i]);
+        }
+        
+        net.load(network.get_weights(), network.get_biases(), 0);
+    }
+    
+    void load_model(const std::string& filename) {
+        NeuralNetwork network({Input, Rest...}, 0.0, CV_32F);
+        network.load_model(filename);
+        load(network);
+    }
+    
+    // Вероятности классов (softmax), output - массив из outputs элементов
+    void forward(const float* input, float* output) const {
+        net.apply(input, output);
+        
+        float max_val = output[0];
+        for (int j = 1; j < outputs; ++j) {
+            max_val = std::max(max_val, output[j]);
+        }
+        
+        float sum = 0.0f;
+        for (int j = 0; j < outputs; ++j) {
+            output[j] = std::exp(output[j] - max_val);
+            sum += output[j];
+        }
+        for (int j = 0; j < outputs; ++j) {
+            output[j] /= sum;
+        }
+    }
+    
+    int predict(const float* input) const {
+        // softmax монотонен - класс определяется по максимуму логитов
+        alignas(64) float logits[outputs];
+        net.apply(input, logits);
+        
+        int best = 0;
+        for (int j = 1; j < outputs; ++j) {
+            if (logits[j] > logits[best]) {
+                best = j;
+            }
+        }
+        return best;
+    }
+    
+    int predict(const cv::Mat& input) const {
+        CV_Assert(static_cast<int>(input.total()) == Input);
+        
+        if (input.type() == CV_32F && input.isContinuous()) {
+            return predict(input.ptr<float>());
+        }
+        
+        alignas(64) float buffer[Input];
+        cv::Mat converted(1, Input, CV_32F, buffer);
+        input.reshape(1, 1).convertTo(converted, CV_32F);
+        return predict(buffer);
+    }
+
+private:
+    FixedLayers<Input, Rest...> net;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "idx_dataset.h"
+#include "model_file.h"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <cstdlib>
+#endif
+
+// Заголовок IDX: 0, 0, тип (0x08 - uint8), число измерений, затем размеры (big-endian)
+static uint32_t read_be32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static bool has_gz_extension(const std::string& filename) {
+    return filename.size() > 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
+
+#ifdef HAVE_ZLIB
+// Каталог файла: распакованный набор по умолчанию кладется рядом со сжатым
+static std::string directory_of(const std::string& filename) {
+    size_t slash = filename.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return ".";
+    }
+    return slash == 0 ? filename.substr(0, 1) : filename.substr(0, slash);
+}
+
+// Потоковая распаковка во временный файл в temp_dir. На POSIX файл удаляется
+// сразу после отображения (отображение остается валидным), на Windows
+// отображенный файл удалить нельзя - он удаляется после закрытия отображения.
+static std::shared_ptr<MappedFile> map_gzip(const std::string& filename, const std::string& temp_dir) {
+    gzFile gz = gzopen(filename.c_str(), "rb");
+    if (!gz) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    
+#ifdef _WIN32
+    char path[MAX_PATH];
+    std::string temp_path;
+    if (GetTempFileNameA(temp_dir.c_str(), "idx", 0, path)) {
+        temp_path = path;
+    }
+    FILE* out = temp_path.empty() ? nullptr : std::fopen(path, "wb");
+#else
+    std::string temp_path = temp_dir + "/idx_XXXXXX";
+    std::vector<char> path(temp_path.begin(), temp_path.end());
+    path.push_back('\0');
+    int fd = mkstemp(path.data());
+    temp_path = path.data();
+    FILE* out = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+#endif
+    if (!out) {
+        gzclose(gz);
+        throw std::runtime_error("Cannot create temporary file in " + temp_dir + " for " + filename);
+    }
+    
+    std::vector<char> chunk(1 << 20);
+    int n;
+    while ((n = gzread(gz, chunk.data(), static_cast<unsigned>(chunk.size()))) > 0) {
+        std::fwrite(chunk.data(), 1, n, out);
+    }
+    
+    bool failed = n < 0 || std::ferror(out);
+    gzclose(gz);
+    std::fclose(out);
+    
+    if (failed) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Cannot decompress file: " + filename);
+    }
+    
+#ifdef _WIN32
+    std::unique_ptr<MappedFile> file;
+    try {
+        file.reset(new MappedFile(temp_path));
+    } catch (...) {
+        std::remove(temp_path.c_str());
+        throw;
+    }
+    return std::shared_ptr<MappedFile>(file.release(), [temp_path](MappedFile* mapped) {
+        delete mapped;
+        std::remove(temp_path.c_str());
+    });
+#else
+    std::shared_ptr<MappedFile> mapped;
+    try {
+        mapped = std::make_shared<MappedFile>(temp_path);
+    } catch (...) {
+        std::remove(temp_path.c_str());
+        throw;
+    }
+    std::remove(temp_path.c_str());
+    return mapped;
+#endif
+}
+#endif
+
+static std::shared_ptr<MappedFile> map_idx(const std::string& filename, const std::string& temp_dir) {
+    if (has_gz_extension(filename)) {
+#ifdef HAVE_ZLIB
+        return map_gzip(filename, temp_dir.empty() ? directory_of(filename) : temp_dir);
+#else
+        throw std::runtime_error("Built without zlib, cannot read " + filename);
+#endif
+    }
+    return std::make_shared<MappedFile>(filename);
+}
+
+// Проверяет заголовок и возвращает размеры; данные начинаются после них
+static std::vector<uint32_t> parse_idx(const MappedFile& file, int expected_dims, const std::string& filename) {
+    const unsigned char* data = file.data();
+    if (file.size() < 4 || data[0] != 0 || data[1] != 0 || data[2] != 0x08 || data[3] != expected_dims) {
+        throw std::runtime_error("Not a uint8 IDX file: " + filename);
+    }
+    
+    size_t header = 4 + 4 * static_cast<size_t>(expected_dims);
+    if (file.size() < header) {
+        throw std::runtime_error("IDX file is truncated: " + filename);
+    }
+    
+    std::vector<uint32_t> dims;
+    size_t total = 1;
+    for (int i = 0; i < expected_dims; ++i) {
+        dims.push_back(read_be32(data + 4 + 4 * i));
+        total *= dims.back();
+    }
+    
+    if (file.size() - header < total) {
+        throw std::runtime_error("IDX file is truncated: " + filename);
+    }
+    return dims;
+}
+
+IdxDataset::IdxDataset(const std::string& images_file, const std::string& labels_file,
+                       int classes, const std::string& temp_dir)
+    : pixels(nullptr), labels(nullptr), count(0), image_rows(0), image_cols(0) {
+    
+    images_map = map_idx(images_file, temp_dir);
+    labels_map = map_idx(labels_file, temp_dir);
+    
+    std::vector<uint32_t> image_dims = parse_idx(*images_map, 3, images_file);
+    std::vector<uint32_t> label_dims = parse_idx(*labels_map, 1, labels_file);
+    
+    if (image_dims[0] != label_dims[0]) {
+        throw std::runtime_error("Image and label counts differ: " + images_file);
+    }
+    
+    count = image_dims[0];
+    image_rows = static_cast<int>(image_dims[1]);
+    image_cols = static_cast<int>(image_dims[2]);
+    pixels = images_map->data() + 16;
+    labels = labels_map->data() + 8;
+    
+    // Метка вне [0, classes) иначе молча дала бы нулевой one-hot вектор
+    for (size_t i = 0; i < count; ++i) {
+        if (labels[i] >= classes) {
+            throw std::runtime_error("Label " + std::to_string(labels[i]) + " at index " + std::to_string(i) +
+                                     " is out of range [0, " + std::to_string(classes) + "): " + labels_file);
+        }
+    }
+}
+
+cv::Mat IdxDataset::image(size_t index) const {
+    CV_Assert(index < count);
+    unsigned char* row = const_cast<unsigned char*>(pixels) + index * sample_size();
+    return cv::Mat(1, sample_size(), CV_8U, row);
+}
+
+int IdxDataset::label(size_t index) const {
+    CV_Assert(index < count);
+    return labels[index];
+}
+
+Dataset IdxDataset::dataset() const {
+    // Копия IdxDataset держит оба отображения, пока жив Dataset
+    std::shared_ptr<IdxDataset> owner = std::make_shared<IdxDataset>(*this);
+    cv::Mat samples(static_cast<int>(count), sample_size(), CV_8U, const_cast<unsigned char*>(pixels));
+    cv::Mat label_data(static_cast<int>(count), 1, CV_8U, const_cast<unsigned char*>(labels));
+    return Dataset(samples, label_data, 1.0 / 255.0, owner);
+}
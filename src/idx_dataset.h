@@ -0,0 +1,48 @@
+#ifndef IDX_DATASET_H
+#define IDX_DATASET_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "dataset.h"
+
+class MappedFile;
+
+// Набор в формате MNIST IDX: файл изображений (uint8, N x rows x cols)
+// и файл меток (uint8, N). Файлы отображаются в память, изображения
+// доступны как uint8-представления без копирования, в точность сети
+// переводятся только строки текущего батча (см. Dataset). Сжатые файлы (*.gz)
+// потоково распаковываются во временный файл, который тоже отображается,
+// поэтому набор не обязан помещаться в память.
+class IdxDataset {
+public:
+    // classes - число классов: метка вне [0, classes) - ошибка открытия.
+    // temp_dir - каталог распакованных *.gz, по умолчанию каталог набора.
+    IdxDataset(const std::string& images_file, const std::string& labels_file,
+               int classes = 10, const std::string& temp_dir = "");
+    
+    size_t size() const { return count; }
+    int sample_size() const { return image_rows * image_cols; }
+    int rows() const { return image_rows; }
+    int cols() const { return image_cols; }
+    
+    // Изображение [1 x rows*cols] CV_8U поверх отображенного файла
+    cv::Mat image(size_t index) const;
+    int label(size_t index) const;
+    
+    // Весь набор как Dataset поверх отображенных файлов (uint8, scale = 1/255)
+    Dataset dataset() const;
+
+private:
+    std::shared_ptr<MappedFile> images_map;
+    std::shared_ptr<MappedFile> labels_map;
+    const unsigned char* pixels;
+    const unsigned char* labels;
+    size_t count;
+    int image_rows;
+    int image_cols;
+};
+
+#endif
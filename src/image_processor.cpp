@@ -3,144 +3,272 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
 
-cv::Mat ImageProcessor::preprocess_image(const cv::Mat& image) {
-    cv::Mat processed;
+// Сторона входа сети
+static const int INPUT_SIDE = 28;
+
+// Одно изображение -> строка батча: серый, 28x28, затем alpha * x + beta
+// одним проходом в точность строки. Промежуточные буферы свои у потока.
+static void preprocess_into(const cv::Mat& image, cv::Mat row, double alpha, double beta) {
+    CV_Assert(!image.empty());
+    
+    static thread_local cv::Mat gray, resized;
+    
+    const cv::Mat* source = &image;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        source = &gray;
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+        source = &gray;
+    }
     
-    if (image.channels() > 1) {
-        cv::cvtColor(image, processed, cv::COLOR_BGR2GRAY);
-    } else {
-        processed = image.clone();
+    if (source->rows != INPUT_SIDE || source->cols != INPUT_SIDE) {
+        cv::resize(*source, resized, cv::Size(INPUT_SIDE, INPUT_SIDE));
+        source = &resized;
     }
     
-    cv::resize(processed, processed, cv::Size(28, 28));
-    processed.convertTo(processed, CV_64F, 1.0 / 255.0);
+    cv::Mat target = row.reshape(1, INPUT_SIDE);
+    source->convertTo(target, row.depth(), alpha, beta);
+}
+
+// Поддерживаемые входы: серый, BGR, BGRA. Проверяется до parallel_for_,
+// чтобы ошибка не возникала в рабочем потоке посреди батча.
+static bool supported_channels(int channels) {
+    return channels == 1 || channels == 3 || channels == 4;
+}
+
+// Батч нужного размера и типа; существующий буфер переиспользуется
+static void prepare_batch(cv::Mat& batch, int count, int depth) {
+    CV_Assert(depth == CV_32F || depth == CV_64F);
+    batch.create(count, INPUT_SIDE * INPUT_SIDE, depth);
+}
+
+cv::Mat ImageProcessor::preprocess_image(const cv::Mat& image, int depth) {
+    CV_Assert(supported_channels(image.channels()));
+    cv::Mat processed;
+    prepare_batch(processed, 1, depth);
+    preprocess_into(image, processed, 1.0 / 255.0, 0.0);
+    return processed;
+}
+
+void ImageProcessor::preprocess_batch(const std::vector<cv::Mat>& images, cv::Mat& batch, 
+                                      int depth, bool invert) {
+    int count = static_cast<int>(images.size());
+    for (int i = 0; i < count; ++i) {
+        CV_Assert(!images[i].empty() && images[i].depth() == CV_8U && supported_channels(images[i].channels()));
+    }
+    prepare_batch(batch, count, depth);
+    
+    double alpha = invert ? -1.0 / 255.0 : 1.0 / 255.0;
+    double beta = invert ? 1.0 : 0.0;
+    
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            preprocess_into(images[i], batch.row(i), alpha, beta);
+        }
+    }, std::max(1.0, count / 16.0));
+}
+
+void ImageProcessor::preprocess_batch(const unsigned char* data, int count, int rows, int cols, int channels,
+                                      cv::Mat& batch, int depth, bool invert) {
+    CV_Assert(data && count >= 0 && rows > 0 && cols > 0 && supported_channels(channels));
+    prepare_batch(batch, count, depth);
     
-    return processed.reshape(1, 1);
+    double alpha = invert ? -1.0 / 255.0 : 1.0 / 255.0;
+    double beta = invert ? 1.0 : 0.0;
+    size_t image_bytes = static_cast<size_t>(rows) * cols * channels;
+    
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            // Заголовок поверх буфера, без копирования
+            cv::Mat image(rows, cols, CV_8UC(channels), const_cast<unsigned char*>(data + i * image_bytes));
+            preprocess_into(image, batch.row(i), alpha, beta);
+        }
+    }, std::max(1.0, count / 16.0));
 }
 
-cv::Mat ImageProcessor::create_target_vector(int digit, int num_classes) {
-    cv::Mat target = cv::Mat::zeros(num_classes, 1, CV_64F);
-    target.at<double>(digit, 0) = 1.0;
+cv::Mat ImageProcessor::create_target_vector(int digit, int num_classes, int depth) {
+    cv::Mat target = cv::Mat::zeros(num_classes, 1, depth);
+    target.row(digit).setTo(1.0);
     return target;
 }
 
-std::vector<cv::Mat> ImageProcessor::generate_test_images(int count) {
-    std::vector<cv::Mat> images;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> noise(0.0, 0.15);
-    std::uniform_real_distribution<> variation(0.7, 1.0);
+// Независимое зерно для (seed, поток, номер): финализатор splitmix64
+static uint32_t mix_seed(uint64_t seed, uint64_t stream, uint64_t index) {
+    uint64_t z = seed;
+    const uint64_t parts[2] = {stream, index};
+    for (int i = 0; i < 2; ++i) {
+        z ^= parts[i];
+        z += 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+    }
+    return static_cast<uint32_t>(z);
+}
+
+// Равномерное [0, 1) без std-распределений: одинаково на всех платформах
+static double uniform01(std::mt19937& gen) {
+    return gen() * (1.0 / 4294967296.0);
+}
+
+// Каждые 10 подряд идущих примеров - перестановка цифр 0..9
+static int sample_digit(unsigned int seed, size_t index) {
+    std::mt19937 gen(mix_seed(seed, 1, index / 10));
+    int digits[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    for (int i = 9; i > 0; --i) {
+        std::swap(digits[i], digits[gen() % (i + 1)]);
+    }
+    return digits[index % 10];
+}
+
+// Фигуры цифр в центрированных координатах (r, c)
+static bool three_bars(double r) {
+    return (r > -9 && r < -5) || (r > -2 && r < 2) || (r > 5 && r < 9);
+}
+
+struct Shape0 { bool operator()(double r, double c) const { return r*r + c*c < 100; } };
+struct Shape1 { bool operator()(double r, double c) const { return std::abs(c) < 3 && r > -10 && r < 10; } };
+struct Shape2 { bool operator()(double r, double c) const {
+    return three_bars(r) || (r >= -5 && r <= -2 && c > 4) || (r >= 2 && r <= 5 && c < -4); } };
+struct Shape3 { bool operator()(double r, double c) const {
+    return three_bars(r) || (c > 4 && r > -5 && r < 5); } };
+struct Shape4 { bool operator()(double r, double c) const {
+    return (c > 4 && r < 0) || (r > -2 && r < 2) || (c < -4 && r > -2); } };
+struct Shape5 { bool operator()(double r, double c) const {
+    return three_bars(r) || (r >= -5 && r <= -2 && c < -4) || (r >= 2 && r <= 5 && c > 4); } };
+struct Shape6 { bool operator()(double r, double c) const {
+    return three_bars(r) || (c < -4 && r > -5 && r < 5) || (r >= 2 && r <= 5 && c > 4); } };
+struct Shape7 { bool operator()(double r, double c) const {
+    return (r > -9 && r < -5) || (c > 4 && r > -5); } };
+struct Shape8 { bool operator()(double r, double c) const {
+    return (r+5)*(r+5) + c*c < 30 || (r-5)*(r-5) + c*c < 30; } };
+struct Shape9 { bool operator()(double r, double c) const {
+    return three_bars(r) || (c > 4 && r > -5 && r < 5) || (r >= -5 && r <= -2 && c < -4); } };
+
+// Растеризация фигуры 28x28 со смещением, масштабом и шумом.
+// Выбор цифры делается один раз, а не на каждый пиксель.
+template <typename Shape, typename T>
+static void rasterize(Shape shape, std::mt19937& gen, T* dst) {
+    double scale = 0.7 + 0.3 * uniform01(gen);
+    double offset_x = (0.7 + 0.3 * uniform01(gen) - 0.5) * 4;
+    double offset_y = (0.7 + 0.3 * uniform01(gen) - 0.5) * 4;
     
-    std::cout << "Generating LARGE dataset with " << count << " samples..." << std::endl;
+    for (int row = 0; row < 28; ++row) {
+        double centered_row = (row - 14 + offset_y) / scale;
+        for (int col = 0; col < 28; ++col) {
+            double centered_col = (col - 14 + offset_x) / scale;
+            double val = shape(centered_row, centered_col) ? 1.0 : 0.0;
+            dst[row * 28 + col] = static_cast<T>(std::min(1.0, val + 0.15 * uniform01(gen)));
+        }
+    }
+}
+
+template <typename T>
+static void render_sample(unsigned int seed, size_t index, int digit, T* dst) {
+    std::mt19937 gen(mix_seed(seed, 0, index));
     
-    // Создаем много вариаций каждой цифры
-    int samples_per_digit = count / 10;
+    switch (digit) {
+        case 0: rasterize(Shape0(), gen, dst); break; // Круг
+        case 1: rasterize(Shape1(), gen, dst); break; // Вертикальная линия
+        case 2: rasterize(Shape2(), gen, dst); break; // Двойка
+        case 3: rasterize(Shape3(), gen, dst); break; // Тройка
+        case 4: rasterize(Shape4(), gen, dst); break; // Четверка
+        case 5: rasterize(Shape5(), gen, dst); break; // Пятерка
+        case 6: rasterize(Shape6(), gen, dst); break; // Шестерка
+        case 7: rasterize(Shape7(), gen, dst); break; // Семерка
+        case 8: rasterize(Shape8(), gen, dst); break; // Восьмерка
+        case 9: rasterize(Shape9(), gen, dst); break; // Девятка
+    }
+}
+
+void ImageProcessor::generate_samples(unsigned int seed, size_t first, int count, int depth,
+                                      cv::Mat& images, cv::Mat& labels) {
+    CV_Assert(depth == CV_32F || depth == CV_64F);
+    images.create(count, 784, depth);
+    labels.create(count, 1, CV_8U);
     
-    for (int digit = 0; digit < 10; ++digit) {
-        for (int variant = 0; variant < samples_per_digit; ++variant) {
-            cv::Mat image = cv::Mat::zeros(1, 784, CV_64F);
-            double scale = variation(gen);
-            double offset_x = (variation(gen) - 0.5) * 4;
-            double offset_y = (variation(gen) - 0.5) * 4;
+    // Каждый пример зависит только от (seed, номер), поэтому разбиение
+    // по потокам не влияет на результат
+    cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+        for (int r = range.start; r < range.end; ++r) {
+            size_t index = first + r;
+            int digit = sample_digit(seed, index);
+            labels.at<uchar>(r, 0) = static_cast<uchar>(digit);
             
-            for (int j = 0; j < 784; ++j) {
-                int row = j / 28;
-                int col = j % 28;
-                double val = 0.0;
-                
-                // С учетом смещения и масштаба
-                double centered_row = (row - 14 + offset_y) / scale;
-                double centered_col = (col - 14 + offset_x) / scale;
-                
-                switch (digit) {
-                    case 0: // Круг
-                        if (centered_row*centered_row + centered_col*centered_col < 100) 
-                            val = 1.0;
-                        break;
-                    case 1: // Вертикальная линия
-                        if (abs(centered_col) < 3 && centered_row > -10 && centered_row < 10) 
-                            val = 1.0;
-                        break;
-                    case 2: // Двойка
-                        if ((centered_row > -9 && centered_row < -5) || 
-                            (centered_row > -2 && centered_row < 2) ||
-                            (centered_row > 5 && centered_row < 9)) val = 1.0;
-                        if (centered_row >= -5 && centered_row <= -2 && centered_col > 4) val = 1.0;
-                        if (centered_row >= 2 && centered_row <= 5 && centered_col < -4) val = 1.0;
-                        break;
-                    case 3: // Тройка
-                        if ((centered_row > -9 && centered_row < -5) || 
-                            (centered_row > -2 && centered_row < 2) ||
-                            (centered_row > 5 && centered_row < 9)) val = 1.0;
-                        if (centered_col > 4 && centered_row > -5 && centered_row < 5) val = 1.0;
-                        break;
-                    case 4: // Четверка
-                        if (centered_col > 4 && centered_row < 0) val = 1.0;
-                        if (centered_row > -2 && centered_row < 2) val = 1.0;
-                        if (centered_col < -4 && centered_row > -2) val = 1.0;
-                        break;
-                    case 5: // Пятерка
-                        if ((centered_row > -9 && centered_row < -5) || 
-                            (centered_row > -2 && centered_row < 2) ||
-                            (centered_row > 5 && centered_row < 9)) val = 1.0;
-                        if (centered_row >= -5 && centered_row <= -2 && centered_col < -4) val = 1.0;
-                        if (centered_row >= 2 && centered_row <= 5 && centered_col > 4) val = 1.0;
-                        break;
-                    case 6: // Шестерка
-                        if ((centered_row > -9 && centered_row < -5) || 
-                            (centered_row > -2 && centered_row < 2) ||
-                            (centered_row > 5 && centered_row < 9)) val = 1.0;
-                        if (centered_col < -4 && centered_row > -5 && centered_row < 5) val = 1.0;
-                        if (centered_row >= 2 && centered_row <= 5 && centered_col > 4) val = 1.0;
-                        break;
-                    case 7: // Семерка
-                        if (centered_row > -9 && centered_row < -5) val = 1.0;
-                        if (centered_col > 4 && centered_row > -5) val = 1.0;
-                        break;
-                    case 8: // Восьмерка
-                        if ((centered_row+5)*(centered_row+5) + centered_col*centered_col < 30) val = 1.0;
-                        if ((centered_row-5)*(centered_row-5) + centered_col*centered_col < 30) val = 1.0;
-                        break;
-                    case 9: // Девятка
-                        if ((centered_row > -9 && centered_row < -5) || 
-                            (centered_row > -2 && centered_row < 2) ||
-                            (centered_row > 5 && centered_row < 9)) val = 1.0;
-                        if (centered_col > 4 && centered_row > -5 && centered_row < 5) val = 1.0;
-                        if (centered_row >= -5 && centered_row <= -2 && centered_col < -4) val = 1.0;
-                        break;
-                }
-                
-                val = std::min(1.0, val + noise(gen));
-                image.at<double>(0, j) = val;
+            if (depth == CV_32F) {
+                render_sample(seed, index, digit, images.ptr<float>(r));
+            } else {
+                render_sample(seed, index, digit, images.ptr<double>(r));
             }
-            
-            images.push_back(image);
         }
-    }
+    }, std::max(1.0, count / 256.0));
+}
+
+Dataset ImageProcessor::generate_dataset(int count, unsigned int seed, int depth) {
+    std::cout << "Generating dataset with " << count << " samples (seed " << seed << ")..." << std::endl;
     
-    // Перемешиваем данные
-    std::shuffle(images.begin(), images.end(), gen);
+    cv::Mat images, labels;
+    generate_samples(seed, 0, count, depth, images, labels);
+    
+    std::cout << "Generated " << count << " training samples with variations" << std::endl;
+    return Dataset(images, labels);
+}
+
+std::vector<cv::Mat> ImageProcessor::generate_test_images(int count, int depth, unsigned int seed) {
+    // Строки общего буфера, без отдельного выделения на изображение
+    Dataset dataset = generate_dataset(count, seed, depth);
     
-    std::cout << "Generated " << images.size() << " training samples with variations" << std::endl;
+    std::vector<cv::Mat> images;
+    for (size_t i = 0; i < dataset.size(); ++i) {
+        images.push_back(dataset.samples().row(static_cast<int>(i)));
+    }
     return images;
 }
 
-std::vector<cv::Mat> ImageProcessor::generate_test_targets(int count) {
+std::vector<cv::Mat> ImageProcessor::generate_test_targets(int count, int depth, unsigned int seed) {
+    // Метки зависят только от seed и номера - совпадают с generate_test_images
     std::vector<cv::Mat> targets;
-    
-    int samples_per_digit = count / 10;
-    
-    for (int digit = 0; digit < 10; ++digit) {
-        for (int variant = 0; variant < samples_per_digit; ++variant) {
-            targets.push_back(create_target_vector(digit));
-        }
+    for (int i = 0; i < count; ++i) {
+        targets.push_back(create_target_vector(sample_digit(seed, i), 10, depth));
     }
-    
-    // Перемешиваем цели
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(targets.begin(), targets.end(), gen);
-    
     return targets;
-}
\ No newline at end of file
+}
+
+template <typename T>
+static void add_noise(T* row, int size, std::mt19937& gen, double amount) {
+    for (int i = 0; i < size; ++i) {
+        row[i] = static_cast<T>(std::min(1.0, row[i] + amount * uniform01(gen)));
+    }
+}
+
+void ImageProcessor::augment_batch(const cv::Mat& images, unsigned int seed, size_t first, cv::Mat& augmented) {
+    CV_Assert(images.cols == 784 && (images.depth() == CV_32F || images.depth() == CV_64F));
+    augmented.create(images.rows, images.cols, images.type());
+    
+    cv::parallel_for_(cv::Range(0, images.rows), [&](const cv::Range& range) {
+        for (int r = range.start; r < range.end; ++r) {
+            std::mt19937 gen(mix_seed(seed, 2, first + r));
+            
+            // Сдвиг до 2 пикселей и масштаб 0.9..1.1 относительно центра
+            double scale = 0.9 + 0.2 * uniform01(gen);
+            double shift_x = 4.0 * uniform01(gen) - 2.0;
+            double shift_y = 4.0 * uniform01(gen) - 2.0;
+            double m[6] = {scale, 0, 14 * (1 - scale) + shift_x,
+                           0, scale, 14 * (1 - scale) + shift_y};
+            cv::Mat transform(2, 3, CV_64F, m);
+            
+            cv::Mat src = images.row(r).reshape(1, 28);
+            cv::Mat dst = augmented.row(r).reshape(1, 28);
+            cv::warpAffine(src, dst, transform, cv::Size(28, 28));
+            
+            if (augmented.depth() == CV_32F) {
+                add_noise(augmented.ptr<float>(r), augmented.cols, gen, 0.15);
+            } else {
+                add_noise(augmented.ptr<double>(r), augmented.cols, gen, 0.15);
+            }
+        }
+    }, std::max(1.0, images.rows / 64.0));
+}
@@ -3,15 +3,49 @@
 
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include "dataset.h"
 
 class ImageProcessor {
 public:
-    static cv::Mat preprocess_image(const cv::Mat& image);
-    static cv::Mat create_target_vector(int digit, int num_classes = 10);
+    // depth - точность результата (CV_32F или CV_64F), как у сети
+    static cv::Mat preprocess_image(const cv::Mat& image, int depth = CV_64F);
     
-    // Генерация тестовых данных (вместо реального MNIST)
-    static std::vector<cv::Mat> generate_test_images(int count);
-    static std::vector<cv::Mat> generate_test_targets(int count);
+    // Предобработка батча: изображения CV_8U любого размера с 1, 3 или 4
+    // каналами -> строки batch [N x 784] точности depth. Каждое изображение
+    // приводится к серому и 28x28, затем нормализуется (и при invert
+    // инвертируется: 1 - x) одним проходом convertTo прямо в свою строку.
+    // batch выделяется, только если его размер или тип не подходят.
+    // Изображения обрабатываются параллельно.
+    static void preprocess_batch(const std::vector<cv::Mat>& images, cv::Mat& batch, 
+                                 int depth = CV_32F, bool invert = false);
+    
+    // То же для упакованного буфера: count изображений rows x cols x channels подряд
+    static void preprocess_batch(const unsigned char* data, int count, int rows, int cols, int channels,
+                                 cv::Mat& batch, int depth = CV_32F, bool invert = false);
+    
+    static cv::Mat create_target_vector(int digit, int num_classes = 10, int depth = CV_64F);
+    
+    static const unsigned int DEFAULT_SEED = 12345;
+    
+    // Генерация тестовых данных (вместо реального MNIST).
+    // Пример с номером i определяется только (seed, i): набор воспроизводим,
+    // генерируется параллельно, изображения и метки всегда согласованы.
+    static Dataset generate_dataset(int count, unsigned int seed = DEFAULT_SEED, int depth = CV_32F);
+    
+    // Примеры [first, first + count) того же потока - для генерации батчей по запросу
+    static void generate_samples(unsigned int seed, size_t first, int count, int depth,
+                                 cv::Mat& images, cv::Mat& labels);
+    
+    // Случайный сдвиг, масштаб и шум для батча [N x 784] (CV_32F/CV_64F).
+    // Искажения строки r зависят только от (seed, first + r).
+    static void augment_batch(const cv::Mat& images, unsigned int seed, size_t first, 
+                              cv::Mat& augmented);
+    
+    // Прежний интерфейс: при одинаковом seed изображения и цели совпадают по порядку
+    static std::vector<cv::Mat> generate_test_images(int count, int depth = CV_64F, 
+                                                     unsigned int seed = DEFAULT_SEED);
+    static std::vector<cv::Mat> generate_test_targets(int count, int depth = CV_64F, 
+                                                      unsigned int seed = DEFAULT_SEED);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,390 @@
+#include "inference_server.h"
+#include "image_processor.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Запросы больше этого считаются ошибкой протокола
+static const uint32_t MAX_REQUEST_BYTES = 16 << 20;
+static const size_t LATENCY_WINDOW = 100000;
+
+static bool read_all(int fd, void* buffer, size_t size) {
+    char* p = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* buffer, size_t size) {
+    const char* p = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t k = static_cast<size_t>(q * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+InferenceServer::InferenceServer(const ModelSnapshots& models, const Options& options)
+    : models(models), options(options), stopping(false), latency_pos(0),
+      request_count(0), batch_count(0), started(std::chrono::steady_clock::now()) {
+    
+    this->options.max_batch = std::max(1, options.max_batch);
+    this->options.max_wait_us = std::max(0, options.max_wait_us);
+    batcher = std::thread(&InferenceServer::batch_loop, this);
+}
+
+InferenceServer::~InferenceServer() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_ready.notify_all();
+    
+    if (batcher.joinable()) {
+        batcher.join();
+    }
+}
+
+int InferenceServer::listen_unix() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create Unix socket");
+    }
+    
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, options.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(options.socket_path.c_str());
+    
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + options.socket_path);
+    }
+    return fd;
+}
+
+int InferenceServer::listen_tcp() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create TCP socket");
+    }
+    
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.tcp_port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on 127.0.0.1:" + std::to_string(options.tcp_port));
+    }
+    return fd;
+}
+
+void InferenceServer::run(const std::atomic<bool>& stop) {
+    std::vector<pollfd> listeners;
+    if (!options.socket_path.empty()) {
+        pollfd p = {listen_unix(), POLLIN, 0};
+        listeners.push_back(p);
+        std::cout << "Listening on " << options.socket_path << std::endl;
+    }
+    if (options.tcp_port > 0) {
+        pollfd p = {listen_tcp(), POLLIN, 0};
+        listeners.push_back(p);
+        std::cout << "Listening on 127.0.0.1:" << options.tcp_port << std::endl;
+    }
+    if (listeners.empty()) {
+        throw std::runtime_error("No socket or TCP port configured");
+    }
+    
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+    
+    while (!stop) {
+        int ready = poll(listeners.data(), listeners.size(), 200);
+        
+        for (size_t i = 0; ready > 0 && i < listeners.size(); ++i) {
+            if (listeners[i].revents & POLLIN) {
+                int client = accept(listeners[i].fd, nullptr, nullptr);
+                if (client >= 0) {
+                    std::lock_guard<std::mutex> lock(clients_mutex);
+                    clients.insert(client);
+                    connections.push_back(std::thread(&InferenceServer::serve, this, client));
+                }
+            }
+        }
+        
+        reap_connections();
+        
+        if (options.report_interval_s > 0 && 
+            std::chrono::steady_clock::now() - last_report > std::chrono::seconds(options.report_interval_s)) {
+            print_stats();
+            last_report = std::chrono::steady_clock::now();
+        }
+    }
+    
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        close(listeners[i].fd);
+    }
+    if (!options.socket_path.empty()) {
+        unlink(options.socket_path.c_str());
+    }
+    
+    // Прерываем ожидание в recv у открытых соединений
+    std::vector<std::thread> remaining;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it) {
+            shutdown(*it, SHUT_RDWR);
+        }
+        remaining.swap(connections);
+        finished.clear();
+    }
+    for (size_t i = 0; i < remaining.size(); ++i) {
+        remaining[i].join();
+    }
+    
+    print_stats();
+}
+
+void InferenceServer::reap_connections() {
+    // Потоки закрытых соединений: иначе каждый клиент оставлял бы
+    // поток со стеком до остановки сервера
+    std::vector<std::thread> done;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        if (finished.empty()) {
+            return;
+        }
+        
+        for (size_t i = 0; i < connections.size(); ) {
+            if (std::find(finished.begin(), finished.end(), connections[i].get_id()) != finished.end()) {
+                done.push_back(std::move(connections[i]));
+                connections.erase(connections.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+        finished.clear();
+    }
+    
+    // serve() уже вышел из цикла, join ждет только close()
+    for (size_t i = 0; i < done.size(); ++i) {
+        done[i].join();
+    }
+}
+
+void InferenceServer::serve(int fd) {
+    while (true) {
+        uint32_t length;
+        if (!read_all(fd, &length, sizeof(length))) {
+            break;
+        }
+        length = ntohl(length);
+        if (length < 5 || length > MAX_REQUEST_BYTES) {
+            break;
+        }
+        
+        std::vector<unsigned char> payload(length);
+        if (!read_all(fd, payload.data(), payload.size())) {
+            break;
+        }
+        
+        std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+        
+        uint16_t rows, cols;
+        std::memcpy(&rows, &payload[0], 2);
+        std::memcpy(&cols, &payload[2], 2);
+        rows = ntohs(rows);
+        cols = ntohs(cols);
+        int channels = payload[4];
+        
+        Reply reply;
+        reply.label = -1;
+        
+        if ((channels == 1 || channels == 3 || channels == 4) && 
+            static_cast<size_t>(rows) * cols * channels + 5 == payload.size()) {
+            try {
+                cv::Mat image(rows, cols, CV_8UC(channels), &payload[5]);
+                int depth = models.acquire()->get_depth();
+                cv::Mat input;
+                if (rows == 28 && cols == 28 && channels == 1) {
+                    image.reshape(1, 1).convertTo(input, depth, 1.0 / 255.0);
+                } else {
+                    input = ImageProcessor::preprocess_image(image, depth);
+                }
+                reply = infer(input);
+            } catch (const std::exception& e) {
+                std::cerr << "Request error: " << e.what() << std::endl;
+            }
+        }
+        
+        // Ответ: метка и вероятности в float32
+        const int classes = 10;
+        std::vector<unsigned char> response(8 + 4 * classes, 0);
+        uint32_t response_length = htonl(static_cast<uint32_t>(response.size() - 4));
+        uint32_t label = htonl(static_cast<uint32_t>(reply.label));
+        std::memcpy(&response[0], &response_length, 4);
+        std::memcpy(&response[4], &label, 4);
+        
+        if (reply.label >= 0) {
+            cv::Mat probs;
+            reply.probabilities.convertTo(probs, CV_32F);
+            for (int j = 0; j < classes && j < probs.cols; ++j) {
+                uint32_t bits;
+                float value = probs.at<float>(0, j);
+                std::memcpy(&bits, &value, 4);
+                bits = htonl(bits);
+                std::memcpy(&response[8 + 4 * j], &bits, 4);
+            }
+        }
+        
+        if (!write_all(fd, response.data(), response.size())) {
+            break;
+        }
+        
+        record_latency(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - received).count());
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        clients.erase(fd);
+        finished.push_back(std::this_thread::get_id());
+    }
+    close(fd);
+}
+
+InferenceServer::Reply InferenceServer::infer(const cv::Mat& input) {
+    Request request;
+    request.input = input;
+    std::future<Reply> result = request.reply.get_future();
+    
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(&request);
+    }
+    queue_ready.notify_one();
+    
+    return result.get();
+}
+
+void InferenceServer::batch_loop() {
+    while (true) {
+        std::vector<Request*> batch;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) {
+                return;
+            }
+            
+            // Ждем добора батча, но не дольше max_wait_us от первого запроса
+            std::chrono::steady_clock::time_point deadline = 
+                std::chrono::steady_clock::now() + std::chrono::microseconds(options.max_wait_us);
+            queue_ready.wait_until(lock, deadline, [this] {
+                return stopping || queue.size() >= static_cast<size_t>(options.max_batch);
+            });
+            
+            size_t n = std::min(queue.size(), static_cast<size_t>(options.max_batch));
+            batch.assign(queue.begin(), queue.begin() + n);
+            queue.erase(queue.begin(), queue.begin() + n);
+        }
+        
+        // Весь батч считается одним снимком модели
+        ModelSnapshots::Reader model = models.acquire();
+        
+        cv::Mat inputs(static_cast<int>(batch.size()), batch.front()->input.cols, model->get_depth());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            batch[i]->input.convertTo(inputs.row(static_cast<int>(i)), inputs.type());
+        }
+        
+        try {
+            cv::Mat probabilities;
+            std::vector<int> labels = model->predict_batch(inputs, &probabilities);
+            
+            for (size_t i = 0; i < batch.size(); ++i) {
+                Reply reply;
+                reply.label = labels[i];
+                reply.probabilities = probabilities.row(static_cast<int>(i)).clone();
+                batch[i]->reply.set_value(reply);
+            }
+        } catch (...) {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i]->reply.set_exception(std::current_exception());
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        batch_count++;
+    }
+}
+
+void InferenceServer::record_latency(double ms) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    request_count++;
+    
+    if (latencies.size() < LATENCY_WINDOW) {
+        latencies.push_back(ms);
+    } else {
+        latencies[latency_pos] = ms;
+        latency_pos = (latency_pos + 1) % LATENCY_WINDOW;
+    }
+}
+
+InferenceServer::Stats InferenceServer::stats() const {
+    std::vector<double> window;
+    Stats s;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        window = latencies;
+        s.requests = request_count;
+        s.batches = batch_count;
+    }
+    
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    s.avg_batch = s.batches ? static_cast<double>(s.requests) / s.batches : 0.0;
+    s.p50_ms = percentile(window, 0.50);
+    s.p99_ms = percentile(window, 0.99);
+    s.throughput = seconds > 0 ? s.requests / seconds : 0.0;
+    return s;
+}
+
+void InferenceServer::print_stats() const {
+    Stats s = stats();
+    std::cout << "Requests: " << s.requests 
+              << " - Batches: " << s.batches << " (avg " << s.avg_batch << ")"
+              << " - p50: " << s.p50_ms << " ms - p99: " << s.p99_ms << " ms"
+              << " - Throughput: " << s.throughput << " req/s" << std::endl;
+}
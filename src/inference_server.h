@@ -0,0 +1,104 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "model_snapshots.h"
+
+// Локальный сервер распознавания (POSIX): Unix-сокет и/или TCP на 127.0.0.1.
+// Одновременные запросы собираются в батч (не больше max_batch, ожидание
+// не дольше max_wait_us с момента первого запроса) и проходят через сеть
+// одним predict_batch. Каждый батч считается последним опубликованным
+// снимком модели, поэтому модель можно обновлять без остановки сервера.
+//
+// Протокол (все целые - big-endian):
+//   запрос: uint32 длина, затем uint16 rows, uint16 cols, uint8 channels
+//           и rows*cols*channels байт пикселей (фон темный, как в MNIST),
+//           channels - 1 (серый), 3 (BGR) или 4 (BGRA).
+//           28x28x1 подается в сеть как есть, остальное - через preprocess_image.
+//   ответ:  uint32 длина, int32 метка (-1 - ошибка), float32[10] вероятности.
+class InferenceServer {
+public:
+    struct Options {
+        std::string socket_path;    // пусто - без Unix-сокета
+        int tcp_port;               // 0 - без TCP
+        int max_batch;
+        int max_wait_us;
+        int report_interval_s;      // 0 - без периодического отчета
+        
+        Options() : tcp_port(0), max_batch(64), max_wait_us(2000), report_interval_s(10) {}
+    };
+    
+    struct Stats {
+        size_t requests;
+        size_t batches;
+        double avg_batch;
+        double p50_ms;
+        double p99_ms;
+        double throughput;          // запросов в секунду с момента запуска
+    };
+    
+    InferenceServer(const ModelSnapshots& models, const Options& options);
+    ~InferenceServer();
+    
+    // Принимает соединения, пока stop не станет true
+    void run(const std::atomic<bool>& stop);
+    
+    Stats stats() const;
+    void print_stats() const;
+
+private:
+    struct Reply {
+        int label;
+        cv::Mat probabilities;
+    };
+    
+    struct Request {
+        cv::Mat input;
+        std::promise<Reply> reply;
+    };
+    
+    const ModelSnapshots& models;
+    Options options;
+    
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<Request*> queue;
+    bool stopping;
+    std::thread batcher;
+    
+    std::mutex clients_mutex;
+    std::set<int> clients;
+    std::vector<std::thread> connections;
+    std::vector<std::thread::id> finished;  // завершившиеся serve(), ждут join
+    
+    mutable std::mutex stats_mutex;
+    std::vector<double> latencies;      // кольцо последних задержек, мс
+    size_t latency_pos;
+    size_t request_count;
+    size_t batch_count;
+    std::chrono::steady_clock::time_point started;
+    
+    int listen_unix();
+    int listen_tcp();
+    void serve(int fd);
+    void reap_connections();
+    void batch_loop();
+    Reply infer(const cv::Mat& input);
+    void record_latency(double ms);
+    
+    InferenceServer(const InferenceServer&);
+    InferenceServer& operator=(const InferenceServer&);
+};
+
+#endif
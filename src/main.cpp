@@ -1,48 +1,277 @@
 #include <iostream>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <opencv2/opencv.hpp>
 #include "neural_network.h"
+#include "model_file.h"
 #include "image_processor.h"
 #include "drawing_interface.h"
+#include "dataset.h"
+#include "idx_dataset.h"
+#include "batch_pipeline.h"
+#include "metrics.h"
+#include "model_snapshots.h"
+#include "evaluator.h"
+#include "checkpoint.h"
 
-int main() {
-    std::cout << "=== LARGE DATASET Digit Recognition ===" << std::endl;
+// Параметры обучения; вместе с источником данных входят в отпечаток кэша
+static const int LAYERS[] = {784, 128, 64, 10};
+static const int DEPTH = CV_32F;
+static const int EPOCHS = 70;
+static const int BATCH_SIZE = 32;
+
+// Шаг подобран для обучения по одному примеру; update() усредняет
+// градиент по батчу, поэтому шаг растет пропорционально размеру батча.
+// Проверка: digit_recognition --retrain, точность - в evaluation.json
+static const double SAMPLE_LEARNING_RATE = 0.01;
+static const double LEARNING_RATE = SAMPLE_LEARNING_RATE * BATCH_SIZE;
+static const int SYNTHETIC_SAMPLES = 500;
+static const int EVALUATION_SAMPLES = 10000;
+
+// Контрольная точка обучения - раз в столько эпох (и при выходе)
+static const int CHECKPOINT_EVERY = 5;
+
+// Размер и FNV-1a содержимого файла: замена набора файлом того же
+// размера (например, с исправленными метками) меняет отпечаток
+static std::string file_fingerprint(const std::string& path) {
+    MappedFile file(path);
     
-    try {
-        NeuralNetwork nn({784, 128, 64, 10}, 0.01);
+    char fingerprint[48];
+    std::snprintf(fingerprint, sizeof(fingerprint), "%llu:%016llx", 
+                  static_cast<unsigned long long>(file.size()),
+                  static_cast<unsigned long long>(ModelFile::checksum(file.data(), file.size())));
+    return fingerprint;
+}
+
+// Имя файла кэша: FNV-1a от топологии, точности, гиперпараметров и описания данных
+static std::string cache_path(const NeuralNetwork& nn, const std::string& data_source) {
+    std::ostringstream key;
+    const std::vector<int>& layers = nn.get_layer_sizes();
+    for (size_t i = 0; i < layers.size(); ++i) {
+        key << layers[i] << "-";
+    }
+    key << "|lr=" << LEARNING_RATE << "|depth=" << (nn.get_depth() == CV_32F ? "32F" : "64F") 
+        << "|epochs=" << EPOCHS << "|batch=" << BATCH_SIZE << "|data=" << data_source;
+    
+    std::string text = key.str();
+    uint64_t hash = ModelFile::checksum(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    
+    char name[64];
+    std::snprintf(name, sizeof(name), "model_cache_%016llx.bin", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+// Обучение на выбранном источнике данных
+static void train_model(NeuralNetwork& nn, bool stream, const std::vector<std::string>& files) {
+    if (stream) {
+        // Батч k: примеры [k * 32, k * 32 + 32) генератора + аугментация.
+        // После контрольной точки поток продолжается с первого батча следующей эпохи.
+        const int batch_size = BATCH_SIZE;
+        const int batches_per_epoch = SYNTHETIC_SAMPLES / batch_size;
+        BatchPipeline pipeline([=](size_t index) {
+            cv::Mat images, labels, augmented;
+            size_t first = index * batch_size;
+            ImageProcessor::generate_samples(ImageProcessor::DEFAULT_SEED, first, batch_size, 
+                                             DEPTH, images, labels);
+            ImageProcessor::augment_batch(images, ImageProcessor::DEFAULT_SEED, first, augmented);
+            return Dataset(augmented, labels);
+        }, std::max(1, cv::getNumberOfCPUs() / 2), 8, 
+           static_cast<size_t>(nn.get_epoch()) * batches_per_epoch);
+        
+        nn.train(pipeline, EPOCHS, batches_per_epoch);
+    } else if (files.size() >= 2) {
+        std::cout << "Loading IDX dataset..." << std::endl;
+        IdxDataset dataset(files[0], files[1], nn.get_layer_sizes().back());
+        std::cout << "Loaded " << dataset.size() << " samples" << std::endl;
         
+        nn.train(dataset.dataset(), EPOCHS, BATCH_SIZE);
+    } else {
         std::cout << "Generating LARGE training dataset..." << std::endl;
-        auto images = ImageProcessor::generate_test_images(500);
-        auto targets = ImageProcessor::generate_test_targets(500);
+        Dataset dataset = ImageProcessor::generate_dataset(SYNTHETIC_SAMPLES, ImageProcessor::DEFAULT_SEED, DEPTH);
         
         std::cout << "Starting training with LARGE dataset..." << std::endl;
-        nn.train(images, targets, 70);
-        
-        // Проверка
-        std::cout << "\n=== Final Test ===" << std::endl;
-        int correct = 0;
-        for (int i = 0; i < 20; i++) {
-            int pred = nn.predict(images[i]);
-            int actual = 0;
-            for (int j = 0; j < targets[i].rows; j++) {
-                if (targets[i].at<double>(j, 0) > 0.5) {
-                    actual = j;
-                    break;
-                }
+        nn.train(dataset, EPOCHS, BATCH_SIZE);
+    }
+}
+
+// Проверка на отложенных данных: тестовый IDX (3-й и 4-й аргументы)
+// или сгенерированный набор с другим seed. Отчет - в evaluation.json.
+static void evaluate_model(const NeuralNetwork& nn, const std::vector<std::string>& files) {
+    std::cout << "\n=== Evaluation ===" << std::endl;
+    
+    Evaluator::Report report;
+    if (files.size() >= 4) {
+        IdxDataset test(files[2], files[3], nn.get_layer_sizes().back());
+        report = Evaluator::evaluate(nn, test.dataset());
+    } else {
+        Dataset test = ImageProcessor::generate_dataset(EVALUATION_SAMPLES, ImageProcessor::DEFAULT_SEED + 1, DEPTH);
+        report = Evaluator::evaluate(nn, test);
+    }
+    
+    report.print();
+    report.save_json("evaluation.json");
+}
+
+// Использование: digit_recognition [--retrain|--cached] [--stream | images labels [test-images test-labels]]
+//   images labels  - обучение на наборе IDX (train-images.idx3-ubyte train-labels.idx1-ubyte),
+//                    test-images test-labels - отложенный набор для проверки
+//   --stream       - обучение на потоке новых примеров, которые генерируются
+//                    и искажаются в фоне
+//   без аргументов - обучение на сгенерированных данных
+// Обученная модель кэшируется в model_cache_<отпечаток>.bin; при совпадении
+// топологии, гиперпараметров и данных она загружается без обучения.
+//   --retrain      - обучить заново и перезаписать кэш
+//   --cached       - только загрузка из кэша, ошибка при промахе
+// Во время обучения каждые CHECKPOINT_EVERY эпох и при выходе в фоне
+// пишется контрольная точка model_cache_<отпечаток>.ckpt; следующий запуск
+// продолжает с нее (кроме --retrain). После обучения точка удаляется.
+// В сборке с DIGIT_METRICS метрики пишутся в файл из DIGIT_METRICS_OUT.
+int main(int argc, char** argv) {
+    std::cout << "=== LARGE DATASET Digit Recognition ===" << std::endl;
+    
+    bool stream = false, retrain = false, cached_only = false;
+    std::vector<std::string> files;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--retrain") {
+            retrain = true;
+        } else if (arg == "--cached") {
+            cached_only = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    
+    if (retrain && cached_only) {
+        std::cerr << "Error: --retrain and --cached are mutually exclusive" << std::endl;
+        return 1;
+    }
+    
+    try {
+        std::unique_ptr<MetricsExporter> metrics = MetricsExporter::from_env();
+        
+        NeuralNetwork nn(std::vector<int>(LAYERS, LAYERS + sizeof(LAYERS) / sizeof(LAYERS[0])), 
+                         LEARNING_RATE, DEPTH);
+        nn.set_num_threads(cv::getNumberOfCPUs());
+        
+        std::ostringstream source;
+        if (stream) {
+            source << "stream:" << ImageProcessor::DEFAULT_SEED << ":" << (SYNTHETIC_SAMPLES / BATCH_SIZE);
+        } else if (files.size() >= 2) {
+            source << "idx:" << file_fingerprint(files[0]) << ":" << file_fingerprint(files[1]);
+        } else {
+            source << "generated:" << ImageProcessor::DEFAULT_SEED << ":" << SYNTHETIC_SAMPLES;
+        }
+        std::string cache = cache_path(nn, source.str());
+        std::string checkpoint = cache.substr(0, cache.size() - 4) + ".ckpt";
+        
+        bool loaded = false;
+        if (!retrain && std::ifstream(cache.c_str()).good()) {
+            try {
+                nn.load_model(cache);
+                loaded = true;
+            } catch (const std::exception& e) {
+                // Поврежденный кэш - обучаем заново
+                std::cerr << "Cache " << cache << " is unusable: " << e.what() << std::endl;
             }
-            std::cout << "Digit " << actual << " -> Prediction: " << pred;
-            if (pred == actual) {
-                std::cout << " ✓";
-                correct++;
+        }
+        
+        if (!loaded && cached_only) {
+            std::cerr << "Error: no cached model " << cache << std::endl;
+            return 1;
+        }
+        
+        // Интерфейс доступен сразу: сеть обучается в фоне и после каждой
+        // эпохи публикует снимок, распознавание берет последний опубликованный
+        ModelSnapshots snapshots(nn);
+        std::atomic<bool> quitting(false);
+        std::atomic<int> trained_epochs(0);
+        std::thread trainer;
+        
+        std::unique_ptr<Checkpointer> checkpointer;
+        
+        if (loaded) {
+            std::cout << "Using cached model, training skipped" << std::endl;
+        } else {
+            if (!retrain && std::ifstream(checkpoint.c_str()).good()) {
+                try {
+                    NeuralNetwork::TrainingState state;
+                    Checkpoint::read(checkpoint, state);
+                    nn.restore_state(state);
+                    snapshots.publish(nn);
+                    trained_epochs = state.epoch;
+                    std::cout << "Checkpoint loaded: " << checkpoint 
+                              << " (epoch " << state.epoch << ")" << std::endl;
+                } catch (const std::exception& e) {
+                    std::cerr << "Checkpoint " << checkpoint << " is unusable: " << e.what() << std::endl;
+                }
             }
-            std::cout << std::endl;
+            
+            // Снимок берется в потоке обучения, на диск пишет поток checkpointer
+            checkpointer.reset(new Checkpointer(checkpoint));
+            
+            nn.set_epoch_callback([&](int epoch, double, double) {
+                snapshots.publish(nn);
+                trained_epochs = epoch;
+                if (quitting || epoch % CHECKPOINT_EVERY == 0) {
+                    checkpointer->submit(nn);
+                }
+                return !quitting;
+            });
+            
+            trainer = std::thread([&] {
+                try {
+                    train_model(nn, stream, files);
+                    
+                    // Прерванное обучение в кэш не попадает
+                    if (trained_epochs < EPOCHS) {
+                        std::cout << "Training stopped after " << trained_epochs 
+                                  << " epochs, model not cached (resume from " 
+                                  << checkpoint << ")" << std::endl;
+                        return;
+                    }
+                    
+                    nn.save_model(cache);
+                    nn.save_model("large_dataset_model.bin");
+                    
+                    // Модель в кэше, точка продолжения больше не нужна
+                    checkpointer->flush();
+                    std::remove(checkpoint.c_str());
+                    evaluate_model(nn, files);
+                } catch (const std::exception& e) {
+                    std::cerr << "Training error: " << e.what() << std::endl;
+                }
+            });
         }
-        std::cout << "Test accuracy: " << (correct * 5) << "%" << std::endl;
         
-        nn.save_model("large_dataset_model.xml");
+        try {
+            std::cout << "\nStarting drawing interface..." << std::endl;
+            DrawingInterface drawingInterface(snapshots);
+            drawingInterface.run();
+        } catch (...) {
+            quitting = true;
+            if (trainer.joinable()) {
+                trainer.join();
+            }
+            throw;
+        }
         
-        std::cout << "\nStarting drawing interface..." << std::endl;
-        DrawingInterface drawingInterface(nn);
-        drawingInterface.run();
+        quitting = true;
+        if (trainer.joinable()) {
+            trainer.join();
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
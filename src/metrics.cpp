@@ -0,0 +1,301 @@
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#ifdef DIGIT_METRICS
+#include "alloc_counter.h"
+#endif
+
+static const double LATENCY_BOUNDS_US[Metrics::LATENCY_BUCKETS - 1] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000
+};
+
+static const char* PHASE_NAMES[2] = {"forward", "backward"};
+
+// Статические атомики обнуляются до запуска программы
+static std::atomic<int64_t> layer_ns[2][Metrics::MAX_LAYERS];
+static std::atomic<uint64_t> layer_calls[2][Metrics::MAX_LAYERS];
+
+static std::atomic<uint64_t> train_steps;
+static std::atomic<uint64_t> train_samples;
+static std::atomic<int64_t> train_ns;
+static std::atomic<uint64_t> train_allocations;
+
+static std::atomic<uint64_t> predict_calls;
+static std::atomic<uint64_t> predict_samples;
+static std::atomic<int64_t> predict_ns;
+static std::atomic<uint64_t> predict_buckets[Metrics::LATENCY_BUCKETS];
+
+bool Metrics::enabled() {
+#ifdef DIGIT_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+int64_t Metrics::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Metrics::allocations() {
+    // Тот же счетчик, что и в digit_bench
+#ifdef DIGIT_METRICS
+    return AllocationCounter::snapshot().count;
+#else
+    return 0;
+#endif
+}
+
+void Metrics::record_layer(Phase phase, int layer, int64_t ns) {
+    if (layer < 0 || layer >= MAX_LAYERS) {
+        return;
+    }
+    layer_ns[phase][layer].fetch_add(ns, std::memory_order_relaxed);
+    layer_calls[phase][layer].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Metrics::layer_call_count(Phase phase, int layer) {
+    if (layer < 0 || layer >= MAX_LAYERS) {
+        return 0;
+    }
+    return layer_calls[phase][layer].load(std::memory_order_relaxed);
+}
+
+uint64_t Metrics::train_step_count() {
+    return train_steps.load(std::memory_order_relaxed);
+}
+
+void Metrics::record_train_step(size_t samples, int64_t ns, uint64_t allocations) {
+    train_steps.fetch_add(1, std::memory_order_relaxed);
+    train_samples.fetch_add(samples, std::memory_order_relaxed);
+    train_ns.fetch_add(ns, std::memory_order_relaxed);
+    train_allocations.fetch_add(allocations, std::memory_order_relaxed);
+}
+
+void Metrics::record_predict(size_t samples, int64_t ns) {
+    predict_calls.fetch_add(1, std::memory_order_relaxed);
+    predict_samples.fetch_add(samples, std::memory_order_relaxed);
+    predict_ns.fetch_add(ns, std::memory_order_relaxed);
+    
+    double us = ns / 1000.0;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && us > LATENCY_BOUNDS_US[bucket]) {
+        bucket++;
+    }
+    predict_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Верхняя граница корзины, в которую попадает квантиль q, мс
+static double latency_quantile_ms(const uint64_t* buckets, uint64_t total, double q) {
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < Metrics::LATENCY_BUCKETS - 1; ++i) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return LATENCY_BOUNDS_US[i] / 1000.0;
+        }
+    }
+    return LATENCY_BOUNDS_US[Metrics::LATENCY_BUCKETS - 2] / 1000.0;
+}
+
+std::string Metrics::prometheus() {
+    std::ostringstream out;
+    
+    out << "# HELP digit_layer_seconds_total Time spent in a layer (summed over threads)\n"
+        << "# TYPE digit_layer_seconds_total counter\n";
+    for (int p = 0; p < 2; ++p) {
+        for (int l = 0; l < MAX_LAYERS; ++l) {
+            if (layer_calls[p][l].load(std::memory_order_relaxed)) {
+                out << "digit_layer_seconds_total{phase=\"" << PHASE_NAMES[p] << "\",layer=\"" << l << "\"} "
+                    << layer_ns[p][l].load(std::memory_order_relaxed) * 1e-9 << "\n";
+            }
+        }
+    }
+    
+    // Проход backward - один замер на слой (на часть батча при параллельном обучении)
+    out << "# HELP digit_layer_calls_total Forward/backward passes through a layer\n"
+        << "# TYPE digit_layer_calls_total counter\n";
+    for (int p = 0; p < 2; ++p) {
+        for (int l = 0; l < MAX_LAYERS; ++l) {
+            uint64_t calls = layer_calls[p][l].load(std::memory_order_relaxed);
+            if (calls) {
+                out << "digit_layer_calls_total{phase=\"" << PHASE_NAMES[p] << "\",layer=\"" << l << "\"} "
+                    << calls << "\n";
+            }
+        }
+    }
+    
+    uint64_t steps = train_steps.load(std::memory_order_relaxed);
+    uint64_t samples = train_samples.load(std::memory_order_relaxed);
+    double seconds = train_ns.load(std::memory_order_relaxed) * 1e-9;
+    
+    out << "# TYPE digit_train_steps_total counter\n"
+        << "digit_train_steps_total " << steps << "\n"
+        << "# TYPE digit_train_samples_total counter\n"
+        << "digit_train_samples_total " << samples << "\n"
+        << "# TYPE digit_train_seconds_total counter\n"
+        << "digit_train_seconds_total " << seconds << "\n"
+        << "# TYPE digit_train_allocations_total counter\n"
+        << "digit_train_allocations_total " << train_allocations.load(std::memory_order_relaxed) << "\n"
+        << "# TYPE digit_train_samples_per_second gauge\n"
+        << "digit_train_samples_per_second " << (seconds > 0 ? samples / seconds : 0.0) << "\n";
+    
+    out << "# HELP digit_predict_latency_seconds Latency of predict/predict_batch calls\n"
+        << "# TYPE digit_predict_latency_seconds histogram\n";
+    uint64_t cumulative = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        cumulative += predict_buckets[i].load(std::memory_order_relaxed);
+        out << "digit_predict_latency_seconds_bucket{le=\"";
+        if (i < LATENCY_BUCKETS - 1) {
+            out << LATENCY_BOUNDS_US[i] * 1e-6;
+        } else {
+            out << "+Inf";
+        }
+        out << "\"} " << cumulative << "\n";
+    }
+    out << "digit_predict_latency_seconds_sum " << predict_ns.load(std::memory_order_relaxed) * 1e-9 << "\n"
+        << "digit_predict_latency_seconds_count " << predict_calls.load(std::memory_order_relaxed) << "\n"
+        << "# TYPE digit_predict_samples_total counter\n"
+        << "digit_predict_samples_total " << predict_samples.load(std::memory_order_relaxed) << "\n";
+    
+    return out.str();
+}
+
+std::string Metrics::json_line() {
+    std::ostringstream out;
+    
+    uint64_t steps = train_steps.load(std::memory_order_relaxed);
+    uint64_t samples = train_samples.load(std::memory_order_relaxed);
+    double seconds = train_ns.load(std::memory_order_relaxed) * 1e-9;
+    uint64_t allocations = train_allocations.load(std::memory_order_relaxed);
+    
+    out << "{\"time_ms\": " << std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count()
+        << ", \"train\": {\"steps\": " << steps 
+        << ", \"samples\": " << samples
+        << ", \"seconds\": " << seconds
+        << ", \"samples_per_sec\": " << (seconds > 0 ? samples / seconds : 0.0)
+        << ", \"allocs_per_step\": " << (steps ? static_cast<double>(allocations) / steps : 0.0) << "}"
+        << ", \"layers\": [";
+    
+    bool first = true;
+    for (int l = 0; l < MAX_LAYERS; ++l) {
+        uint64_t calls = layer_calls[FORWARD][l].load(std::memory_order_relaxed) + 
+                         layer_calls[BACKWARD][l].load(std::memory_order_relaxed);
+        if (!calls) {
+            continue;
+        }
+        out << (first ? "" : ", ") << "{\"layer\": " << l
+            << ", \"forward_ms\": " << layer_ns[FORWARD][l].load(std::memory_order_relaxed) * 1e-6
+            << ", \"backward_ms\": " << layer_ns[BACKWARD][l].load(std::memory_order_relaxed) * 1e-6
+            << ", \"forward_calls\": " << layer_calls[FORWARD][l].load(std::memory_order_relaxed)
+            << ", \"backward_calls\": " << layer_calls[BACKWARD][l].load(std::memory_order_relaxed) << "}";
+        first = false;
+    }
+    
+    uint64_t buckets[LATENCY_BUCKETS];
+    uint64_t calls = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        buckets[i] = predict_buckets[i].load(std::memory_order_relaxed);
+        calls += buckets[i];
+    }
+    
+    out << "], \"predict\": {\"calls\": " << calls
+        << ", \"samples\": " << predict_samples.load(std::memory_order_relaxed)
+        << ", \"p50_ms\": " << latency_quantile_ms(buckets, calls, 0.50)
+        << ", \"p99_ms\": " << latency_quantile_ms(buckets, calls, 0.99)
+        << ", \"buckets\": [";
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        out << (i ? ", " : "") << buckets[i];
+    }
+    out << "]}}";
+    
+    return out.str();
+}
+
+MetricsExporter::MetricsExporter(const std::string& path, int interval_ms)
+    : path(path), interval_ms(std::max(100, interval_ms)), stopping(false) {
+    
+    const std::string ext = ".jsonl";
+    json_lines = path.size() >= ext.size() && 
+                 path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+    
+#ifdef DIGIT_METRICS
+    AllocationCounter::install();
+#endif
+    thread = std::thread(&MetricsExporter::loop, this);
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    
+    if (thread.joinable()) {
+        thread.join();
+    }
+    
+    // Итоговый снимок при завершении
+    write();
+}
+
+std::unique_ptr<MetricsExporter> MetricsExporter::from_env() {
+    const char* path = std::getenv("DIGIT_METRICS_OUT");
+    if (!path || !*path) {
+        return std::unique_ptr<MetricsExporter>();
+    }
+    
+    if (!Metrics::enabled()) {
+        std::cerr << "Warning: DIGIT_METRICS_OUT is set, but the build has no DIGIT_METRICS" << std::endl;
+        return std::unique_ptr<MetricsExporter>();
+    }
+    
+    const char* interval = std::getenv("DIGIT_METRICS_INTERVAL_MS");
+    return std::unique_ptr<MetricsExporter>(
+        new MetricsExporter(path, interval ? std::atoi(interval) : 5000));
+}
+
+void MetricsExporter::write() const {
+    if (json_lines) {
+        std::ofstream file(path.c_str(), std::ios::app);
+        file << Metrics::json_line() << "\n";
+        return;
+    }
+    
+    // Читатель никогда не видит наполовину записанный файл
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp.c_str());
+        file << Metrics::prometheus();
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+void MetricsExporter::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(interval_ms));
+        if (stopping) {
+            break;
+        }
+        
+        lock.unlock();
+        write();
+        lock.lock();
+    }
+}
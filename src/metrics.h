@@ -0,0 +1,115 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Метрики горячего пути: время слоев в forward/backward, шаги обучения
+// (примеры/с, выделения памяти на шаг) и гистограмма задержек predict.
+//
+// Сбор включается только при сборке с DIGIT_METRICS (cmake -DDIGIT_METRICS=ON).
+// Без него макросы METRICS_* ничего не генерируют и горячий путь не меняется.
+// Счетчики - атомики без блокировок; время слоев при параллельном
+// обучении суммируется по потокам.
+class Metrics {
+public:
+    enum Phase { FORWARD = 0, BACKWARD = 1 };
+    static const int MAX_LAYERS = 16;
+    
+    // Границы корзин гистограммы predict, мкс (последняя корзина - +Inf)
+    static const int LATENCY_BUCKETS = 14;
+    
+    static bool enabled();
+    static int64_t now_ns();
+    static uint64_t allocations();
+    
+    static void record_layer(Phase phase, int layer, int64_t ns);
+    static void record_train_step(size_t samples, int64_t ns, uint64_t allocations);
+    static void record_predict(size_t samples, int64_t ns);
+    
+    // Число замеров слоя и шагов обучения с начала программы
+    static uint64_t layer_call_count(Phase phase, int layer);
+    static uint64_t train_step_count();
+    
+    // Снимок в текстовом формате Prometheus / одной строкой JSON
+    static std::string prometheus();
+    static std::string json_line();
+    
+    // Замеры в пределах области видимости
+    class LayerTimer {
+    public:
+        LayerTimer(Phase phase, int layer) : phase(phase), layer(layer), start(now_ns()) {}
+        ~LayerTimer() { record_layer(phase, layer, now_ns() - start); }
+    private:
+        Phase phase;
+        int layer;
+        int64_t start;
+    };
+    
+    class StepTimer {
+    public:
+        explicit StepTimer(size_t samples) 
+            : samples(samples), start(now_ns()), allocated(allocations()) {}
+        ~StepTimer() { record_train_step(samples, now_ns() - start, allocations() - allocated); }
+    private:
+        size_t samples;
+        int64_t start;
+        uint64_t allocated;
+    };
+    
+    class PredictTimer {
+    public:
+        explicit PredictTimer(size_t samples) : samples(samples), start(now_ns()) {}
+        ~PredictTimer() { record_predict(samples, now_ns() - start); }
+    private:
+        size_t samples;
+        int64_t start;
+    };
+};
+
+#ifdef DIGIT_METRICS
+#define METRICS_LAYER(phase, layer) Metrics::LayerTimer metrics_layer_timer(Metrics::phase, layer)
+#define METRICS_TRAIN_STEP(samples) Metrics::StepTimer metrics_step_timer(samples)
+#define METRICS_PREDICT(samples) Metrics::PredictTimer metrics_predict_timer(samples)
+#else
+#define METRICS_LAYER(phase, layer) do {} while (0)
+#define METRICS_TRAIN_STEP(samples) do {} while (0)
+#define METRICS_PREDICT(samples) do {} while (0)
+#endif
+
+// Периодическая выгрузка метрик в файл фоновым потоком:
+// *.jsonl - дописывается строка JSON, иначе файл Prometheus
+// целиком перезаписывается (через временный файл и rename).
+class MetricsExporter {
+public:
+    MetricsExporter(const std::string& path, int interval_ms = 5000);
+    ~MetricsExporter();
+    
+    // Из переменных DIGIT_METRICS_OUT и DIGIT_METRICS_INTERVAL_MS;
+    // nullptr, если путь не задан или сборка без DIGIT_METRICS
+    static std::unique_ptr<MetricsExporter> from_env();
+    
+    void write() const;
+
+private:
+    std::string path;
+    bool json_lines;
+    int interval_ms;
+    
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread thread;
+    
+    void loop();
+    
+    MetricsExporter(const MetricsExporter&);
+    MetricsExporter& operator=(const MetricsExporter&);
+};
+
+#endif
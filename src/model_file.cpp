@@ -0,0 +1,298 @@
+#include "model_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MODEL_MAGIC[4] = {'D', 'G', 'N', 'N'};
+
+static size_t align_up(size_t offset) {
+    return (offset + ModelFile::ALIGNMENT - 1) / ModelFile::ALIGNMENT * ModelFile::ALIGNMENT;
+}
+
+MappedFile::MappedFile(const std::string& filename) : bytes(nullptr), length(0) {
+#ifdef _WIN32
+    // FILE_SHARE_DELETE - пока файл открыт, write_file может его переименовать
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    length = static_cast<size_t>(file_size.QuadPart);
+    
+    HANDLE mapping = length ? CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL) : NULL;
+    if (mapping) {
+        bytes = static_cast<unsigned char*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        length = static_cast<size_t>(st.st_size);
+    }
+    
+    if (length > 0) {
+        void* ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            bytes = static_cast<unsigned char*>(ptr);
+        }
+    }
+    close(fd);
+#endif
+    
+    if (!bytes) {
+        throw std::runtime_error("Cannot map file: " + filename);
+    }
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+#else
+    munmap(bytes, length);
+#endif
+}
+
+uint64_t ModelFile::checksum(const unsigned char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool ModelFile::is_binary(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[4] = {0};
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+void ModelFile::write(const std::string& filename, const std::vector<int>& layer_sizes,
+                      double learning_rate, const std::vector<cv::Mat>& weights,
+                      const std::vector<cv::Mat>& biases) {
+    write_file(filename, serialize(layer_sizes, learning_rate, weights, biases));
+}
+
+// Сбрасывает на диск запись о переименовании в каталоге filename.
+// Не все файловые системы поддерживают fsync каталога - ошибка не критична.
+static void sync_directory(const std::string& filename) {
+#ifndef _WIN32
+    size_t slash = filename.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash == 0 ? 1 : slash);
+    
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#else
+    (void)filename;
+#endif
+}
+
+#ifdef _WIN32
+// Отображенный файл (модель, загруженная этим или другим процессом)
+// Windows не дает заменить, но дает переименовать: старый файл уходит
+// в filename.old и удаляется, когда отображений не останется
+static bool replace_mapped(const std::string& temp, const std::string& filename) {
+    DWORD error = GetLastError();
+    if (error != ERROR_ACCESS_DENIED && error != ERROR_SHARING_VIOLATION && 
+        error != ERROR_USER_MAPPED_FILE) {
+        return false;
+    }
+    
+    std::string old = filename + ".old";
+    DeleteFileA(old.c_str());
+    if (!MoveFileExA(filename.c_str(), old.c_str(), MOVEFILE_WRITE_THROUGH)) {
+        return false;
+    }
+    if (!MoveFileExA(temp.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        MoveFileExA(old.c_str(), filename.c_str(), MOVEFILE_WRITE_THROUGH);
+        return false;
+    }
+    
+    // Пока старый файл отображен, удаление не пройдет - его уберет следующая запись
+    DeleteFileA(old.c_str());
+    return true;
+}
+#endif
+
+void ModelFile::write_file(const std::string& filename, const std::vector<unsigned char>& buffer) {
+    std::string temp = filename + ".tmp";
+    
+    // Данные должны быть на диске до переименования, иначе после сбоя
+    // питания на месте модели может оказаться пустой файл
+    FILE* file = std::fopen(temp.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Cannot write file: " + temp);
+    }
+    bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && 
+                   std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("Cannot write file: " + temp);
+    }
+    
+#ifdef _WIN32
+    bool replaced = MoveFileExA(temp.c_str(), filename.c_str(), 
+                                MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0 ||
+                    replace_mapped(temp, filename);
+#else
+    bool replaced = std::rename(temp.c_str(), filename.c_str()) == 0;
+#endif
+    if (!replaced) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("Cannot replace file: " + filename);
+    }
+    
+    sync_directory(filename);
+}
+
+std::vector<unsigned char> ModelFile::serialize(const std::vector<int>& layer_sizes,
+                                                double learning_rate, const std::vector<cv::Mat>& weights,
+                                                const std::vector<cv::Mat>& biases) {
+    CV_Assert(!weights.empty() && weights.size() == biases.size());
+    CV_Assert(layer_sizes.size() == weights.size() + 1);
+    
+    int depth = weights.front().depth();
+    size_t elem = weights.front().elemSize();
+    
+    // Собираем все, что после заголовка, в один буфер с выравниванием блоков
+    size_t offset = align_up(sizeof(ModelFileHeader) + layer_sizes.size() * sizeof(int32_t));
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        CV_Assert(weights[i].depth() == depth && biases[i].depth() == depth);
+        CV_Assert(weights[i].rows == layer_sizes[i] && weights[i].cols == layer_sizes[i + 1]);
+        CV_Assert(static_cast<int>(biases[i].total()) == layer_sizes[i + 1]);
+        
+        offsets.push_back(offset);
+        offset = align_up(offset + weights[i].total() * elem);
+        offsets.push_back(offset);
+        offset = align_up(offset + biases[i].total() * elem);
+    }
+    
+    std::vector<unsigned char> buffer(offset, 0);
+    
+    std::vector<int32_t> sizes(layer_sizes.begin(), layer_sizes.end());
+    std::memcpy(&buffer[sizeof(ModelFileHeader)], sizes.data(), sizes.size() * sizeof(int32_t));
+    
+    for (size_t i = 0; i < weights.size(); ++i) {
+        cv::Mat w(weights[i].rows, weights[i].cols, weights[i].type(), &buffer[offsets[2 * i]]);
+        cv::Mat b(1, layer_sizes[i + 1], biases[i].type(), &buffer[offsets[2 * i + 1]]);
+        weights[i].copyTo(w);
+        biases[i].reshape(1, 1).copyTo(b);
+    }
+    
+    ModelFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.depth = static_cast<uint32_t>(depth);
+    header.layer_count = static_cast<uint32_t>(layer_sizes.size());
+    header.learning_rate = learning_rate;
+    header.payload_size = buffer.size() - sizeof(ModelFileHeader);
+    header.checksum = checksum(&buffer[sizeof(ModelFileHeader)], header.payload_size);
+    std::memcpy(&buffer[0], &header, sizeof(header));
+    
+    return buffer;
+}
+
+ModelData ModelFile::read(const std::string& filename, bool verify_checksum) {
+    return read(std::make_shared<MappedFile>(filename), 0, filename, verify_checksum);
+}
+
+ModelData ModelFile::read(const std::shared_ptr<MappedFile>& mapped, size_t base, 
+                          const std::string& filename, bool verify_checksum) {
+    // Смещения блоков считаются от base, выравнивание сохраняется
+    CV_Assert(base % ALIGNMENT == 0);
+    if (mapped->size() < base) {
+        throw std::runtime_error("Model file is truncated: " + filename);
+    }
+    const unsigned char* data = mapped->data() + base;
+    size_t available = mapped->size() - base;
+    
+    ModelFileHeader header;
+    if (available < sizeof(header)) {
+        throw std::runtime_error("Model file is truncated: " + filename);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    
+    if (std::memcmp(header.magic, MODEL_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("Not a binary model file: " + filename);
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error("Unsupported model version in " + filename);
+    }
+    if (header.depth != CV_32F && header.depth != CV_64F) {
+        throw std::runtime_error("Unsupported model dtype in " + filename);
+    }
+    if (header.layer_count < 2 || available - sizeof(header) < header.payload_size) {
+        throw std::runtime_error("Model file is truncated: " + filename);
+    }
+    if (verify_checksum && checksum(data + sizeof(header), header.payload_size) != header.checksum) {
+        throw std::runtime_error("Model checksum mismatch: " + filename);
+    }
+    
+    ModelData model;
+    model.learning_rate = header.learning_rate;
+    model.depth = static_cast<int>(header.depth);
+    model.storage = mapped;
+    
+    size_t end = sizeof(header) + header.payload_size;
+    size_t offset = sizeof(header) + header.layer_count * sizeof(int32_t);
+    if (offset > end) {
+        throw std::runtime_error("Model file is truncated: " + filename);
+    }
+    
+    std::vector<int32_t> sizes(header.layer_count);
+    std::memcpy(sizes.data(), data + sizeof(header), sizes.size() * sizeof(int32_t));
+    model.layer_sizes.assign(sizes.begin(), sizes.end());
+    
+    size_t elem = header.depth == CV_32F ? sizeof(float) : sizeof(double);
+    offset = align_up(offset);
+    
+    // Матрицы - заголовки поверх отображенной памяти, без копирования
+    for (size_t i = 0; i + 1 < model.layer_sizes.size(); ++i) {
+        int in = model.layer_sizes[i];
+        int out = model.layer_sizes[i + 1];
+        
+        size_t weight_offset = offset;
+        size_t bias_offset = align_up(weight_offset + static_cast<size_t>(in) * out * elem);
+        offset = align_up(bias_offset + static_cast<size_t>(out) * elem);
+        if (in <= 0 || out <= 0 || offset > end) {
+            throw std::runtime_error("Model file is truncated: " + filename);
+        }
+        
+        model.weights.push_back(cv::Mat(in, out, model.depth, const_cast<unsigned char*>(data) + weight_offset));
+        model.biases.push_back(cv::Mat(1, out, model.depth, const_cast<unsigned char*>(data) + bias_offset));
+    }
+    
+    return model;
+}
@@ -0,0 +1,94 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Файл, отображенный в память в режиме copy-on-write:
+// страницы общие для всех процессов, пока их никто не меняет,
+// изменения (например, дообучение весов) в файл не попадают.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    
+    unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    unsigned char* bytes;
+    size_t length;
+    
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// Бинарный формат модели (версия 1, little-endian):
+//   заголовок ModelFileHeader (64 байта)
+//   int32 layer_sizes[layer_count]
+//   для каждого слоя: веса [in x out], затем смещения [1 x out],
+//   каждый блок выровнен на 64 байта от начала модели.
+// checksum - FNV-1a 64 по всему, что идет после заголовка.
+// При чтении структура (сигнатура, размеры, смещения) проверяется всегда,
+// checksum - только по запросу: полная проверка читает весь файл и
+// лишает отображение ленивой загрузки страниц.
+struct ModelFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t depth;
+    uint32_t layer_count;
+    double learning_rate;
+    uint64_t payload_size;
+    uint64_t checksum;
+    unsigned char reserved[24];
+};
+
+// Параметры модели; при чтении бинарного файла матрицы ссылаются
+// на отображенную память, storage держит отображение живым
+struct ModelData {
+    std::vector<int> layer_sizes;
+    double learning_rate;
+    int depth;
+    std::vector<cv::Mat> weights;
+    std::vector<cv::Mat> biases;
+    std::shared_ptr<MappedFile> storage;
+};
+
+class ModelFile {
+public:
+    static const uint32_t VERSION = 1;
+    static const size_t ALIGNMENT = 64;
+    
+    // Файл начинается с сигнатуры бинарного формата
+    static bool is_binary(const std::string& filename);
+    
+    static void write(const std::string& filename, const std::vector<int>& layer_sizes,
+                      double learning_rate, const std::vector<cv::Mat>& weights,
+                      const std::vector<cv::Mat>& biases);
+    
+    // Пишет buffer во временный файл, сбрасывает его на диск и атомарно
+    // подменяет им filename: отображения старого файла остаются целыми,
+    // новые видят только полностью записанный файл, в том числе после сбоя
+    static void write_file(const std::string& filename, const std::vector<unsigned char>& buffer);
+    
+    // Содержимое файла модели в памяти (для встраивания в другие файлы)
+    static std::vector<unsigned char> serialize(const std::vector<int>& layer_sizes,
+                                                double learning_rate, const std::vector<cv::Mat>& weights,
+                                                const std::vector<cv::Mat>& biases);
+    
+    // Отображает файл в память и оборачивает блоки весов без копирования
+    static ModelData read(const std::string& filename, bool verify_checksum = false);
+    
+    // Модель, записанная с выровненного на ALIGNMENT смещения base
+    // уже отображенного файла
+    static ModelData read(const std::shared_ptr<MappedFile>& mapped, size_t base, 
+                          const std::string& filename, bool verify_checksum = false);
+    
+    static uint64_t checksum(const unsigned char* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "model_snapshots.h"
+#include <thread>
+
+ModelSnapshots::ModelSnapshots(const NeuralNetwork& initial) 
+    : current(0), latest(0), published(0) {
+    for (int i = 0; i < SLOTS; ++i) {
+        slots[i].reset(new Slot(initial));
+    }
+}
+
+void ModelSnapshots::publish(const NeuralNetwork& network) {
+    std::lock_guard<std::mutex> lock(publish_mutex);
+    int active = current.load();
+    
+    // Свободный слот: не текущий и без читателей. Читатель, успевший
+    // увеличить счетчик старого слота, перепроверит current и отступит,
+    // поэтому ожидание короткое.
+    int target = -1;
+    while (target < 0) {
+        for (int i = 1; i < SLOTS && target < 0; ++i) {
+            int candidate = (active + i) % SLOTS;
+            if (slots[candidate]->readers.load() == 0) {
+                target = candidate;
+            }
+        }
+        if (target < 0) {
+            std::this_thread::yield();
+        }
+    }
+    
+    Slot& slot = *slots[target];
+    slot.network.copy_parameters(network);
+    slot.version = ++published;
+    
+    current.store(target);
+    latest.store(slot.version);
+}
+
+ModelSnapshots::Reader ModelSnapshots::acquire() const {
+    while (true) {
+        int index = current.load();
+        Slot* slot = slots[index].get();
+        
+        // Слот захвачен, только если он все еще текущий после увеличения
+        // счетчика - иначе писатель мог начать его перезапись
+        slot->readers.fetch_add(1);
+        if (current.load() == index) {
+            return Reader(slot);
+        }
+        slot->readers.fetch_sub(1);
+    }
+}
+
+uint64_t ModelSnapshots::version() const {
+    return latest.load();
+}
@@ -0,0 +1,72 @@
+#ifndef MODEL_SNAPSHOTS_H
+#define MODEL_SNAPSHOTS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "neural_network.h"
+
+// Неизменяемые снимки сети для распознавания во время обучения.
+// Писатель (поток обучения, перезагрузка модели) копирует параметры в
+// свободный слот и атомарно делает его текущим. Читатели берут текущий
+// слот без блокировок: счетчик читателей слота не дает писателю
+// перезаписать снимок, пока им пользуются.
+class ModelSnapshots {
+private:
+    struct Slot {
+        explicit Slot(const NeuralNetwork& network) 
+            : network(network.clone()), version(0), readers(0) {}
+        
+        NeuralNetwork network;
+        uint64_t version;
+        std::atomic<int> readers;
+    };
+
+public:
+    // Доступ к снимку; снимок не меняется, пока жив Reader
+    class Reader {
+    public:
+        Reader(Reader&& other) : slot(other.slot) { other.slot = nullptr; }
+        ~Reader() { if (slot) slot->readers.fetch_sub(1); }
+        
+        const NeuralNetwork& operator*() const { return slot->network; }
+        const NeuralNetwork* operator->() const { return &slot->network; }
+        uint64_t version() const { return slot->version; }
+        
+    private:
+        friend class ModelSnapshots;
+        explicit Reader(Slot* slot) : slot(slot) {}
+        
+        Slot* slot;
+        
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+    };
+    
+    explicit ModelSnapshots(const NeuralNetwork& initial);
+    
+    // Публикует копию network как новую версию; копирование идет вне
+    // пути чтения, читатели продолжают работать со старым снимком
+    void publish(const NeuralNetwork& network);
+    
+    // Текущий снимок; без блокировок
+    Reader acquire() const;
+    
+    // Номер текущей версии (0 - исходная сеть)
+    uint64_t version() const;
+
+private:
+    static const int SLOTS = 3;
+    
+    std::unique_ptr<Slot> slots[SLOTS];
+    std::atomic<int> current;
+    std::atomic<uint64_t> latest;
+    std::mutex publish_mutex;       // только между писателями
+    uint64_t published;
+    
+    ModelSnapshots(const ModelSnapshots&);
+    ModelSnapshots& operator=(const ModelSnapshots&);
+};
+
+#endif
@@ -1,116 +1,512 @@
 #include "neural_network.h"
+#include "model_file.h"
+#include "dataset.h"
+#include "batch_pipeline.h"
+#include "metrics.h"
 #include <random>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 #include <cmath>
+#include <algorithm>
 
-NeuralNetwork::NeuralNetwork(const std::vector<int>& layers, double lr) 
-    : layer_sizes(layers), learning_rate(lr) {
+// Минимальный размер части батча в параллельном режиме predict_batch
+const int PREDICT_CHUNK_ROWS = 256;
+
+// Доля пикселей не фона в батче, ниже которой первый слой
+// считается по строкам весов только этих пикселей
+const double SPARSE_INPUT_DENSITY = 0.25;
+
+// Минимум строк на поток при параллельном обучении: на меньших частях
+// сведение dw/db и запуск потоков дороже самих gemm
+const int MIN_SHARD_ROWS = 8;
+
+NeuralNetwork::NeuralNetwork(const std::vector<int>& layers, double lr, int depth, int seed) 
+    : layer_sizes(layers), learning_rate(lr), depth(depth), num_threads(1),
+      completed_epochs(0), resume_epoch(0), steps(0) {
+    
+    CV_Assert(depth == CV_32F || depth == CV_64F);
     
+    // Отрицательный seed - случайная инициализация.
+    // Тот же генератор потом перемешивает порядок примеров по эпохам.
     std::random_device rd;
-    std::mt19937 gen(rd());
+    rng.seed(seed < 0 ? rd() : static_cast<unsigned int>(seed));
     std::uniform_real_distribution<> d(-0.5, 0.5);
     
     for (size_t i = 0; i < layer_sizes.size() - 1; ++i) {
         cv::Mat w(layer_sizes[i], layer_sizes[i + 1], CV_64F);
-        cv::Mat b(1, layer_sizes[i + 1], CV_64F);
+        cv::Mat b(1, layer_sizes[i + 1], depth, cv::Scalar(0.1));
         
         for (int r = 0; r < w.rows; ++r) {
             for (int c = 0; c < w.cols; ++c) {
-                w.at<double>(r, c) = d(gen);
+                w.at<double>(r, c) = d(rng);
             }
         }
         
-        for (int c = 0; c < b.cols; ++c) {
-            b.at<double>(0, c) = 0.1;
-        }
+        // Одинаковая инициализация для любой точности
+        w.convertTo(w, depth);
         
         weights.push_back(w);
         biases.push_back(b);
     }
+    
+    update_input_sums();
 }
 
-cv::Mat NeuralNetwork::sigmoid(const cv::Mat& x) {
-    cv::Mat result;
-    cv::exp(-x, result);
-    return 1.0 / (1.0 + result);
+void NeuralNetwork::update_input_sums() {
+    // Суммы столбцов первого слоя - вклад единичного фона в разреженном режиме
+    cv::reduce(weights.front(), input_column_sums, 0, cv::REDUCE_SUM, depth);
 }
 
-cv::Mat NeuralNetwork::sigmoid_derivative(const cv::Mat& x) {
-    cv::Mat s = sigmoid(x);
-    return s.mul(1 - s);
+void NeuralNetwork::Workspace::reserve(const std::vector<int>& layer_sizes, int batch, int type) {
+    bool same_layout = layer_sizes == layout && type == depth;
+    if (same_layout && batch <= rows) {
+        return;
+    }
+    
+    // Растем только вверх, чтобы чередование размеров батча не вызывало перевыделений
+    rows = std::max(batch, same_layout ? rows : 0);
+    layout = layer_sizes;
+    depth = type;
+    
+    size_t layers = layer_sizes.size() - 1;
+    outputs.resize(layers);
+    delta_buffers.resize(layers);
+    dw.resize(layers);
+    db.resize(layers);
+    activations.assign(layers + 1, cv::Mat());
+    deltas.assign(layers, cv::Mat());
+    
+    for (size_t i = 0; i < layers; ++i) {
+        outputs[i].create(rows, layer_sizes[i + 1], depth);
+        delta_buffers[i].create(rows, layer_sizes[i + 1], depth);
+        dw[i].create(layer_sizes[i], layer_sizes[i + 1], depth);
+        db[i].create(1, layer_sizes[i + 1], depth);
+    }
 }
 
-cv::Mat NeuralNetwork::softmax(const cv::Mat& x) {
-    double maxVal;
-    cv::minMaxLoc(x, nullptr, &maxVal);
+// z += b по строкам, затем сигмоида или softmax - за один проход, на месте
+template <typename T>
+static void activate_rows(cv::Mat& z, const cv::Mat& bias, bool softmax) {
+    const T* b = bias.ptr<T>();
     
-    cv::Mat exp_x;
-    cv::exp(x - maxVal, exp_x);
-    
-    cv::Mat sum;
-    cv::reduce(exp_x, sum, 1, cv::REDUCE_SUM);
+    for (int r = 0; r < z.rows; ++r) {
+        T* row = z.ptr<T>(r);
+        
+        if (!softmax) {
+            for (int c = 0; c < z.cols; ++c) {
+                row[c] = T(1) / (T(1) + std::exp(-(row[c] + b[c])));
+            }
+            continue;
+        }
+        
+        T max_val = row[0] + b[0];
+        for (int c = 0; c < z.cols; ++c) {
+            row[c] += b[c];
+            max_val = std::max(max_val, row[c]);
+        }
+        
+        double sum = 0.0;
+        for (int c = 0; c < z.cols; ++c) {
+            row[c] = static_cast<T>(std::exp(row[c] - max_val));
+            sum += row[c];
+        }
+        
+        for (int c = 0; c < z.cols; ++c) {
+            row[c] = static_cast<T>(row[c] / sum);
+        }
+    }
+}
+
+// delta *= s * (1 - s): производная сигмоиды через ее же значение
+template <typename T>
+static void sigmoid_backward(cv::Mat& delta, const cv::Mat& activation) {
+    for (int r = 0; r < delta.rows; ++r) {
+        T* d = delta.ptr<T>(r);
+        const T* a = activation.ptr<T>(r);
+        for (int c = 0; c < delta.cols; ++c) {
+            d[c] *= a[c] * (1 - a[c]);
+        }
+    }
+}
+
+// Сумма строк в db [1 x cols]
+template <typename T>
+static void sum_rows(const cv::Mat& delta, cv::Mat& db) {
+    T* sum = db.ptr<T>();
+    std::fill(sum, sum + db.cols, T(0));
     
-    cv::Mat result(x.rows, x.cols, CV_64F);
-    for (int i = 0; i < x.rows; ++i) {
-        double row_sum = sum.at<double>(i, 0);
-        for (int j = 0; j < x.cols; ++j) {
-            result.at<double>(i, j) = exp_x.at<double>(i, j) / row_sum;
+    for (int r = 0; r < delta.rows; ++r) {
+        const T* d = delta.ptr<T>(r);
+        for (int c = 0; c < delta.cols; ++c) {
+            sum[c] += d[c];
         }
     }
+}
+
+// Кросс-энтропия и число верных ответов батча
+template <typename T>
+static void score_rows(const cv::Mat& output, const cv::Mat& target, double& loss, int& correct) {
+    for (int r = 0; r < output.rows; ++r) {
+        const T* o = output.ptr<T>(r);
+        const T* t = target.ptr<T>(r);
+        int predicted = 0, actual = 0;
+        
+        for (int c = 0; c < output.cols; ++c) {
+            if (o[c] > o[predicted]) predicted = c;
+            if (t[c] > t[actual]) actual = c;
+            loss -= t[c] * std::log(o[c] + 1e-8);
+        }
+        
+        if (predicted == actual) {
+            correct++;
+        }
+    }
+}
+
+// Фон изображения - 0 (MNIST, сгенерированные данные) или 1 (инвертированный
+// холст интерфейса). Возвращает число пикселей строки, отличных от фона.
+template <typename T>
+static int count_foreground(const T* row, int cols, T& background) {
+    int zeros = 0, ones = 0;
+    for (int c = 0; c < cols; ++c) {
+        zeros += row[c] == T(0);
+        ones += row[c] == T(1);
+    }
+    background = ones > zeros ? T(1) : T(0);
+    return cols - std::max(zeros, ones);
+}
+
+template <typename T>
+static bool is_sparse_input(const cv::Mat& input) {
+    size_t foreground = 0;
+    for (int r = 0; r < input.rows; ++r) {
+        T background;
+        foreground += count_foreground(input.ptr<T>(r), input.cols, background);
+    }
+    return foreground <= SPARSE_INPUT_DENSITY * input.rows * input.cols;
+}
+
+// z = x * W по строкам W только для пикселей не фона b:
+// x * W = b * colsum(W) + (x - b) * W, а (x - b) почти везде ноль
+template <typename T>
+static void sparse_first_layer(const cv::Mat& input, const cv::Mat& weights, 
+                               const cv::Mat& column_sums, cv::Mat& z) {
+    const T* sums = column_sums.ptr<T>();
     
-    return result;
+    for (int r = 0; r < input.rows; ++r) {
+        const T* x = input.ptr<T>(r);
+        T* out = z.ptr<T>(r);
+        
+        T background;
+        count_foreground(x, input.cols, background);
+        for (int c = 0; c < z.cols; ++c) {
+            out[c] = background * sums[c];
+        }
+        
+        for (int k = 0; k < input.cols; ++k) {
+            if (x[k] == background) {
+                continue;
+            }
+            T value = x[k] - background;
+            const T* w = weights.ptr<T>(k);
+            for (int c = 0; c < z.cols; ++c) {
+                out[c] += value * w[c];
+            }
+        }
+    }
+}
+
+std::vector<cv::Mat> NeuralNetwork::forward(const cv::Mat& input) const {
+    // Отдельный workspace: активации остаются у вызывающего
+    Workspace workspace;
+    forward(input, workspace);
+    return workspace.activations;
 }
 
-std::vector<cv::Mat> NeuralNetwork::forward(const cv::Mat& input) {
-    std::vector<cv::Mat> activations;
-    cv::Mat current = input.clone();
-    activations.push_back(current);
+const cv::Mat& NeuralNetwork::forward(const cv::Mat& input, Workspace& workspace) const {
+    CV_Assert(input.cols == layer_sizes.front() && input.type() == depth);
+    
+    workspace.reserve(layer_sizes, input.rows, depth);
+    workspace.activations[0] = input;
+    
+    // Рисунки и MNIST в основном фон: первый слой (большая часть
+    // вычислений) тогда быстрее считать разреженно
+    bool sparse = depth == CV_32F ? is_sparse_input<float>(input) : is_sparse_input<double>(input);
     
     for (size_t i = 0; i < weights.size(); ++i) {
-        cv::Mat z = current * weights[i] + biases[i];
+        METRICS_LAYER(FORWARD, static_cast<int>(i));
+        
+        // z = a * W в готовый буфер, смещение добавляется без cv::repeat
+        cv::Mat& z = workspace.activations[i + 1];
+        z = workspace.outputs[i].rowRange(0, input.rows);
         
-        if (i == weights.size() - 1) {
-            current = softmax(z);
+        if (i == 0 && sparse) {
+            if (depth == CV_32F) {
+                sparse_first_layer<float>(input, weights[0], input_column_sums, z);
+            } else {
+                sparse_first_layer<double>(input, weights[0], input_column_sums, z);
+            }
+        } else {
+            cv::gemm(workspace.activations[i], weights[i], 1.0, cv::noArray(), 0.0, z);
+        }
+        
+        bool last = i == weights.size() - 1;
+        if (depth == CV_32F) {
+            activate_rows<float>(z, biases[i], last);
+        } else {
+            activate_rows<double>(z, biases[i], last);
+        }
+    }
+    
+    return workspace.activations.back();
+}
+
+void NeuralNetwork::backward(const cv::Mat& target, Workspace& workspace) const {
+    // workspace содержит активации forward() для батча, target: [N x classes]
+    std::vector<cv::Mat>& activations = workspace.activations;
+    std::vector<cv::Mat>& deltas = workspace.deltas;
+    int rows = activations[0].rows;
+    
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        deltas[i] = workspace.delta_buffers[i].rowRange(0, rows);
+    }
+    
+    cv::subtract(activations.back(), target, deltas.back());
+    
+    // Слой i: градиенты его весов и ошибка, переданная через них
+    // предыдущему слою - один замер на слой за шаг
+    for (int i = static_cast<int>(weights.size()) - 1; i >= 0; --i) {
+        METRICS_LAYER(BACKWARD, i);
+        
+        // Суммарные (не усредненные) градиенты по батчу
+        cv::gemm(activations[i], deltas[i], 1.0, cv::noArray(), 0.0, workspace.dw[i], cv::GEMM_1_T);
+        if (depth == CV_32F) {
+            sum_rows<float>(deltas[i], workspace.db[i]);
         } else {
-            current = sigmoid(z);
+            sum_rows<double>(deltas[i], workspace.db[i]);
+        }
+        
+        if (i == 0) {
+            break;
         }
         
-        activations.push_back(current);
+        // Ошибка delta[i] * W[i]^T пишется сразу в буфер delta[i - 1]
+        cv::gemm(deltas[i], weights[i], 1.0, cv::noArray(), 0.0, deltas[i - 1], cv::GEMM_2_T);
+        if (depth == CV_32F) {
+            sigmoid_backward<float>(deltas[i - 1], activations[i]);
+        } else {
+            sigmoid_backward<double>(deltas[i - 1], activations[i]);
+        }
+    }
+}
+
+void NeuralNetwork::compute_gradients(const cv::Mat& input, const cv::Mat& target, 
+                                      Workspace& workspace) const {
+    // Один прямой проход: потери, точность и градиенты считаются по одним активациям
+    const cv::Mat& output = forward(input, workspace);
+    
+    workspace.loss = 0.0;
+    workspace.correct = 0;
+    if (depth == CV_32F) {
+        score_rows<float>(output, target, workspace.loss, workspace.correct);
+    } else {
+        score_rows<double>(output, target, workspace.loss, workspace.correct);
+    }
+    
+    backward(target, workspace);
+}
+
+void NeuralNetwork::update(const std::vector<cv::Mat>& dw, const std::vector<cv::Mat>& db, int count) {
+    // Один шаг на батч с усредненным градиентом, на месте
+    double step = learning_rate / count;
+    
+    for (size_t i = 0; i < weights.size(); ++i) {
+        cv::scaleAdd(dw[i], -step, weights[i], weights[i]);
+        cv::scaleAdd(db[i], -step, biases[i], biases[i]);
+    }
+    
+    steps++;
+    update_input_sums();
+}
+
+void NeuralNetwork::train_step(const cv::Mat& input, const cv::Mat& target, 
+                               double& loss, int& correct) {
+    METRICS_TRAIN_STEP(input.rows);
+    
+    int shards = std::max(1, std::min(num_threads, input.rows / MIN_SHARD_ROWS));
+    if (workspaces.size() < static_cast<size_t>(shards)) {
+        workspaces.resize(shards);
+    }
+    
+    Workspace& total = workspaces[0];
+    
+    if (shards == 1) {
+        compute_gradients(input, target, total);
+    } else {
+        // Каждый поток считает градиенты своей части батча в свой workspace,
+        // веса и смещения в это время только читаются
+        cv::parallel_for_(cv::Range(0, shards), [&](const cv::Range& range) {
+            for (int s = range.start; s < range.end; ++s) {
+                int begin = input.rows * s / shards;
+                int end = input.rows * (s + 1) / shards;
+                compute_gradients(input.rowRange(begin, end), target.rowRange(begin, end), workspaces[s]);
+            }
+        }, shards);
+        
+        // Сводим в фиксированном порядке, чтобы результат не зависел от планировщика
+        for (int s = 1; s < shards; ++s) {
+            for (size_t i = 0; i < weights.size(); ++i) {
+                total.dw[i] += workspaces[s].dw[i];
+                total.db[i] += workspaces[s].db[i];
+            }
+            total.loss += workspaces[s].loss;
+            total.correct += workspaces[s].correct;
+        }
+    }
+    
+    loss += total.loss;
+    correct += total.correct;
+    update(total.dw, total.db, input.rows);
+}
+
+void NeuralNetwork::set_epoch_callback(const EpochCallback& callback) {
+    epoch_callback = callback;
+}
+
+void NeuralNetwork::capture_state(TrainingState& state) const {
+    state.layer_sizes = layer_sizes;
+    state.learning_rate = learning_rate;
+    state.epoch = completed_epochs;
+    state.steps = steps;
+    
+    state.weights.resize(weights.size());
+    state.biases.resize(biases.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i].copyTo(state.weights[i]);
+        biases[i].copyTo(state.biases[i]);
     }
     
-    return activations;
+    // Текстовое представление mt19937 - стандартное и переносимое
+    std::ostringstream rng_state;
+    rng_state << rng;
+    state.rng = rng_state.str();
 }
 
-void NeuralNetwork::backward(const cv::Mat& input, const cv::Mat& target) {
-    auto activations = forward(input);
-    std::vector<cv::Mat> deltas(weights.size());
+void NeuralNetwork::restore_state(const TrainingState& state) {
+    CV_Assert(state.layer_sizes.size() >= 2 && state.weights.size() == state.layer_sizes.size() - 1 &&
+              state.biases.size() == state.weights.size());
     
-    cv::Mat output = activations.back();
-    cv::Mat target_t = target.t();
-    cv::Mat output_error = output - target_t;
-    deltas.back() = output_error;
+    std::istringstream rng_state(state.rng);
+    rng_state >> rng;
+    if (!rng_state) {
+        throw std::runtime_error("Invalid RNG state in training checkpoint");
+    }
+    
+    model_storage.reset();
+    layer_sizes = state.layer_sizes;
+    learning_rate = state.learning_rate;
     
-    for (int i = weights.size() - 2; i >= 0; --i) {
-        cv::Mat error = deltas[i + 1] * weights[i + 1].t();
-        cv::Mat sp = sigmoid_derivative(activations[i + 1]);
-        deltas[i] = error.mul(sp);
+    weights.resize(state.weights.size());
+    biases.resize(state.biases.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        state.weights[i].convertTo(weights[i], depth);
+        state.biases[i].convertTo(biases[i], depth);
+    }
+    
+    completed_epochs = resume_epoch = state.epoch;
+    steps = state.steps;
+    workspaces.clear();
+    update_input_sums();
+}
+
+int NeuralNetwork::get_epoch() const {
+    return completed_epochs;
+}
+
+NeuralNetwork NeuralNetwork::clone() const {
+    NeuralNetwork copy(*this);
+    copy.epoch_callback = EpochCallback();
+    copy.workspaces.clear();
+    copy.weights.clear();
+    copy.biases.clear();
+    copy.model_storage.reset();
+    // Копия конструктора разделяет буфер сумм: обучение этой сети
+    // переписывало бы его под читателями копии
+    copy.input_column_sums.release();
+    copy.copy_parameters(*this);
+    return copy;
+}
+
+void NeuralNetwork::copy_parameters(const NeuralNetwork& other) {
+    if (model_storage) {
+        // Не пишем в отображенный файл, берем свои буферы
+        weights.clear();
+        biases.clear();
+        model_storage.reset();
     }
     
+    layer_sizes = other.layer_sizes;
+    learning_rate = other.learning_rate;
+    depth = other.depth;
+    
+    weights.resize(other.weights.size());
+    biases.resize(other.biases.size());
+    
     for (size_t i = 0; i < weights.size(); ++i) {
-        cv::Mat dw = activations[i].t() * deltas[i];
-        weights[i] -= learning_rate * dw;
-        biases[i] -= learning_rate * deltas[i];
+        other.weights[i].copyTo(weights[i]);
+        other.biases[i].copyTo(biases[i]);
     }
+    update_input_sums();
+}
+
+void NeuralNetwork::set_num_threads(int threads) {
+    num_threads = std::max(1, threads);
+}
+
+int NeuralNetwork::get_num_threads() const {
+    return num_threads;
+}
+
+int NeuralNetwork::get_depth() const {
+    return depth;
+}
+
+const std::vector<int>& NeuralNetwork::get_layer_sizes() const {
+    return layer_sizes;
 }
 
-int NeuralNetwork::predict(const cv::Mat& input) {
+const std::vector<cv::Mat>& NeuralNetwork::get_weights() const {
+    return weights;
+}
+
+const std::vector<cv::Mat>& NeuralNetwork::get_biases() const {
+    return biases;
+}
+
+int NeuralNetwork::predict(const cv::Mat& input) const {
     try {
-        auto activations = forward(input);
-        cv::Mat output = activations.back();
+        CV_Assert(static_cast<int>(input.total()) == layer_sizes.front());
+        METRICS_PREDICT(1);
+        
+        // Без выделений памяти после первого вызова в потоке: свои
+        // workspace и буфер приведения точности у каждого потока
+        static thread_local Workspace workspace;
+        static thread_local cv::Mat converted;
+        
+        cv::Mat row = input.reshape(1, 1);
+        if (row.type() != depth) {
+            row.convertTo(converted, depth);
+            row = converted;
+        }
         
+        const cv::Mat& output = forward(row, workspace);
         cv::Point max_loc;
         cv::minMaxLoc(output, nullptr, nullptr, nullptr, &max_loc);
+        
+        // Не держим вход вызывающего до конца жизни потока
+        workspace.activations[0].release();
         return max_loc.x;
         
     } catch (const std::exception& e) {
@@ -119,66 +515,271 @@ int NeuralNetwork::predict(const cv::Mat& input) {
     }
 }
 
+std::vector<int> NeuralNetwork::predict_batch(const cv::Mat& inputs, cv::Mat* probabilities, 
+                                              bool parallel) const {
+    std::vector<int> labels(inputs.rows, -1);
+    if (inputs.empty()) {
+        return labels;
+    }
+    
+    CV_Assert(inputs.cols == layer_sizes.front());
+    METRICS_PREDICT(inputs.rows);
+    
+    cv::Mat batch = inputs;
+    if (batch.type() != depth) {
+        inputs.convertTo(batch, depth);
+    }
+    
+    cv::Mat output;
+    if (probabilities) {
+        output.create(batch.rows, layer_sizes.back(), depth);
+    }
+    
+    // Каждая часть пишет только в свои строки labels/output
+    auto classify = [&](int begin, int end) {
+        // Свой workspace у каждого потока: повторные вызовы не выделяют память
+        static thread_local Workspace workspace;
+        const cv::Mat& result = forward(batch.rowRange(begin, end), workspace);
+        
+        for (int r = 0; r < result.rows; ++r) {
+            cv::Point max_loc;
+            cv::minMaxLoc(result.row(r), nullptr, nullptr, nullptr, &max_loc);
+            labels[begin + r] = max_loc.x;
+        }
+        
+        if (probabilities) {
+            result.copyTo(output.rowRange(begin, end));
+        }
+        
+        // Ссылка на батч вызывающего не должна жить в workspace потока
+        workspace.activations[0].release();
+    };
+    
+    int chunks = parallel ? (batch.rows + PREDICT_CHUNK_ROWS - 1) / PREDICT_CHUNK_ROWS : 1;
+    
+    if (chunks <= 1) {
+        classify(0, batch.rows);
+    } else {
+        cv::parallel_for_(cv::Range(0, chunks), [&](const cv::Range& range) {
+            for (int c = range.start; c < range.end; ++c) {
+                classify(c * PREDICT_CHUNK_ROWS, std::min(batch.rows, (c + 1) * PREDICT_CHUNK_ROWS));
+            }
+        }, chunks);
+    }
+    
+    if (probabilities) {
+        *probabilities = output;
+    }
+    
+    return labels;
+}
+
+std::vector<int> NeuralNetwork::predict_batch(const std::vector<cv::Mat>& inputs, cv::Mat* probabilities, 
+                                              bool parallel) const {
+    // Собираем изображения в одну матрицу [N x 784]
+    cv::Mat batch(static_cast<int>(inputs.size()), layer_sizes.front(), depth);
+    
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        CV_Assert(static_cast<int>(inputs[i].total()) == layer_sizes.front());
+        inputs[i].reshape(1, 1).convertTo(batch.row(static_cast<int>(i)), batch.type());
+    }
+    
+    return predict_batch(batch, probabilities, parallel);
+}
+
+std::vector<int> NeuralNetwork::predict_batch(const Dataset& dataset, cv::Mat* probabilities, 
+                                              bool parallel) const {
+    // Набор переводится в точность сети частями, а не целиком
+    const size_t chunk = 16 * PREDICT_CHUNK_ROWS;
+    std::vector<int> labels;
+    labels.reserve(dataset.size());
+    
+    cv::Mat output;
+    if (probabilities) {
+        output.create(static_cast<int>(dataset.size()), layer_sizes.back(), depth);
+    }
+    
+    for (size_t begin = 0; begin < dataset.size(); begin += chunk) {
+        size_t end = std::min(dataset.size(), begin + chunk);
+        cv::Mat part_probabilities;
+        std::vector<int> part = predict_batch(dataset.inputs(begin, end, depth), 
+                                              probabilities ? &part_probabilities : nullptr, parallel);
+        labels.insert(labels.end(), part.begin(), part.end());
+        
+        if (probabilities) {
+            part_probabilities.copyTo(output.rowRange(static_cast<int>(begin), static_cast<int>(end)));
+        }
+    }
+    
+    if (probabilities) {
+        *probabilities = output;
+    }
+    
+    return labels;
+}
+
+int NeuralNetwork::take_resume_epoch(int epochs) {
+    // После restore_state начинаем с сохраненной эпохи, иначе с нуля
+    int first_epoch = std::min(resume_epoch, epochs);
+    resume_epoch = 0;
+    completed_epochs = first_epoch;
+    
+    if (first_epoch > 0) {
+        std::cout << "Resuming from epoch " << first_epoch << "/" << epochs << std::endl;
+    }
+    return first_epoch;
+}
+
 double NeuralNetwork::train(const std::vector<cv::Mat>& inputs, 
                            const std::vector<cv::Mat>& targets, 
                            int epochs, int batch_size) {
-    
-    if (inputs.empty() || targets.empty()) {
+    // Один раз собираем непрерывный набор, порядок примеров сохраняется
+    return train(Dataset::from_vectors(inputs, targets, depth), epochs, batch_size, false);
+}
+
+double NeuralNetwork::train(const Dataset& dataset, int epochs, int batch_size, bool shuffle) {
+    if (dataset.empty()) {
         std::cerr << "Error: No training data!" << std::endl;
         return 0.0;
     }
     
-    std::cout << "Training: " << inputs.size() << " samples, " << epochs << " epochs" << std::endl;
+    CV_Assert(dataset.sample_size() == layer_sizes.front());
+    
+    if (batch_size < 1) {
+        batch_size = 1;
+    }
+    
+    size_t count = dataset.size();
+    std::cout << "Training: " << count << " samples, " << epochs << " epochs, batch " << batch_size << std::endl;
+    
+    // Перемешивается только порядок индексов, сами примеры не копируются
+    std::vector<size_t> order(count);
     
-    for (int epoch = 0; epoch < epochs; ++epoch) {
+    double avg_loss = 0.0;
+    cv::Mat batch_inputs, batch_targets;
+    
+    int first_epoch = take_resume_epoch(epochs);
+    
+    for (int epoch = first_epoch; epoch < epochs; ++epoch) {
         double total_loss = 0.0;
         int correct = 0;
         
-        for (size_t i = 0; i < inputs.size(); ++i) {
+        if (shuffle) {
+            // Каждую эпоху перемешивается тождественный порядок: он зависит
+            // только от состояния rng, и после restore_state батчи те же
+            for (size_t i = 0; i < count; ++i) {
+                order[i] = i;
+            }
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+        
+        for (size_t start = 0; start < count; start += batch_size) {
             try {
-                backward(inputs[i], targets[i]);
-                
-                int prediction = predict(inputs[i]);
-                int actual = -1;
-                for (int j = 0; j < targets[i].rows; ++j) {
-                    if (targets[i].at<double>(j, 0) > 0.5) {
-                        actual = j;
-                        break;
-                    }
-                }
-                
-                if (prediction == actual && actual != -1) {
-                    correct++;
+                // Батч в точности сети: по примеру в строке
+                size_t end = std::min(count, start + static_cast<size_t>(batch_size));
+                if (shuffle) {
+                    dataset.batch(order, start, end, depth, layer_sizes.back(), batch_inputs, batch_targets);
+                } else {
+                    dataset.batch(start, end, depth, layer_sizes.back(), batch_inputs, batch_targets);
                 }
                 
-                auto activations = forward(inputs[i]);
-                cv::Mat output = activations.back();
-                cv::Mat log_output;
-                cv::log(output + 1e-8, log_output);
-                cv::Mat loss_mat = -targets[i].t() * log_output.t();
-                total_loss += loss_mat.at<double>(0, 0);
+                train_step(batch_inputs, batch_targets, total_loss, correct);
                 
             } catch (const std::exception& e) {
                 continue;
             }
         }
         
-        double accuracy = static_cast<double>(correct) / inputs.size();
-        double avg_loss = total_loss / inputs.size();
+        double accuracy = static_cast<double>(correct) / count;
+        avg_loss = total_loss / count;
+        
+        std::cout << "Epoch " << (epoch + 1) << "/" << epochs 
+                  << " - Loss: " << avg_loss 
+                  << " - Accuracy: " << (accuracy * 100) << "%" << std::endl;
+        
+        completed_epochs = epoch + 1;
+        if (epoch_callback && !epoch_callback(epoch + 1, avg_loss, accuracy)) {
+            break;
+        }
+    }
+    
+    return avg_loss;
+}
+
+double NeuralNetwork::train(BatchPipeline& pipeline, int epochs, int batches_per_epoch) {
+    std::cout << "Training: " << batches_per_epoch << " streamed batches per epoch, " 
+              << epochs << " epochs" << std::endl;
+    
+    double avg_loss = 0.0;
+    cv::Mat batch_inputs, batch_targets;
+    
+    // Конвейер должен начинаться с батча first_epoch * batches_per_epoch
+    int first_epoch = take_resume_epoch(epochs);
+    
+    for (int epoch = first_epoch; epoch < epochs; ++epoch) {
+        double total_loss = 0.0;
+        int correct = 0;
+        size_t count = 0;
+        
+        for (int b = 0; b < batches_per_epoch; ++b) {
+            // Следующий батч уже подготовлен фоновыми потоками
+            Dataset batch = pipeline.next();
+            if (batch.empty()) {
+                break;
+            }
+            
+            batch.batch(0, batch.size(), depth, layer_sizes.back(), batch_inputs, batch_targets);
+            train_step(batch_inputs, batch_targets, total_loss, correct);
+            count += batch.size();
+        }
+        
+        double accuracy = count ? static_cast<double>(correct) / count : 0.0;
+        avg_loss = count ? total_loss / count : 0.0;
         
         std::cout << "Epoch " << (epoch + 1) << "/" << epochs 
                   << " - Loss: " << avg_loss 
                   << " - Accuracy: " << (accuracy * 100) << "%" << std::endl;
+        
+        completed_epochs = epoch + 1;
+        if (epoch_callback && !epoch_callback(epoch + 1, avg_loss, accuracy)) {
+            break;
+        }
     }
     
-    return 0.0;
+    BatchPipeline::Stats stats = pipeline.stats();
+    std::cout << "Pipeline: " << stats.workers << " workers, depth " << stats.queue_depth
+              << ", trainer stalled " << stats.consumer_stall_ms << " ms"
+              << ", producers stalled " << stats.producer_stall_ms << " ms" << std::endl;
+    
+    return avg_loss;
 }
 
 void NeuralNetwork::save_model(const std::string& filename) {
+    // *.bin - бинарный формат, иначе XML/YAML через FileStorage
+    const std::string binary_ext = ".bin";
+    if (filename.size() >= binary_ext.size() &&
+        filename.compare(filename.size() - binary_ext.size(), binary_ext.size(), binary_ext) == 0) {
+        // Веса в отображении загруженного файла переносятся в свою память:
+        // отображение освобождается, и файл можно заменить (на Windows
+        // отображенный файл не перезаписывается)
+        if (model_storage) {
+            for (size_t i = 0; i < weights.size(); ++i) {
+                weights[i] = weights[i].clone();
+                biases[i] = biases[i].clone();
+            }
+            model_storage.reset();
+        }
+        
+        ModelFile::write(filename, layer_sizes, learning_rate, weights, biases);
+        std::cout << "Model saved: " << filename << std::endl;
+        return;
+    }
+    
     cv::FileStorage fs(filename, cv::FileStorage::WRITE);
     
     fs << "layer_sizes" << layer_sizes;
     fs << "learning_rate" << learning_rate;
+    fs << "depth" << depth;
     
     for (size_t i = 0; i < weights.size(); ++i) {
         fs << "weight_" + std::to_string(i) << weights[i];
@@ -190,7 +791,29 @@ void NeuralNetwork::save_model(const std::string& filename) {
 }
 
 void NeuralNetwork::load_model(const std::string& filename) {
+    if (ModelFile::is_binary(filename)) {
+        // Веса ссылаются на отображенный файл; копия делается только
+        // при смене точности
+        ModelData model = ModelFile::read(filename);
+        
+        layer_sizes = model.layer_sizes;
+        learning_rate = model.learning_rate;
+        weights = model.weights;
+        biases = model.biases;
+        model_storage = model.storage;
+        
+        for (size_t i = 0; i < weights.size(); ++i) {
+            weights[i].convertTo(weights[i], depth);
+            biases[i].convertTo(biases[i], depth);
+        }
+        
+        update_input_sums();
+        std::cout << "Model loaded: " << filename << std::endl;
+        return;
+    }
+    
     cv::FileStorage fs(filename, cv::FileStorage::READ);
+    model_storage.reset();
     
     cv::FileNode node = fs["layer_sizes"];
     if (node.isSeq()) {
@@ -205,15 +828,20 @@ void NeuralNetwork::load_model(const std::string& filename) {
     weights.clear();
     biases.clear();
     
+    // Веса приводятся к точности этой сети, независимо от точности в файле
     for (size_t i = 0; i < layer_sizes.size() - 1; ++i) {
         cv::Mat w, b;
         fs["weight_" + std::to_string(i)] >> w;
         fs["bias_" + std::to_string(i)] >> b;
         
+        w.convertTo(w, depth);
+        b.convertTo(b, depth);
+        
         weights.push_back(w);
         biases.push_back(b);
     }
     
     fs.release();
+    update_input_sums();
     std::cout << "Model loaded: " << filename << std::endl;
 }
\ No newline at end of file
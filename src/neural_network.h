@@ -1,21 +1,132 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <functional>
+#include <memory>
+#include <random>
 #include <opencv2/opencv.hpp>
 
+class MappedFile;
+class Dataset;
+class BatchPipeline;
+
 class NeuralNetwork {
 public:
-    NeuralNetwork(const std::vector<int>& layers, double lr = 0.1);
+    // Буферы прямого и обратного прохода для батча до capacity() строк.
+    // Выделяются при первом вызове (или при росте батча) и дальше
+    // переиспользуются: forward и шаг обучения идут без выделений памяти.
+    // Один workspace используется одним потоком.
+    class Workspace {
+    public:
+        Workspace() : rows(0), depth(-1), loss(0.0), correct(0) {}
+        
+        void reserve(const std::vector<int>& layer_sizes, int batch, int depth);
+        int capacity() const { return rows; }
+        
+    private:
+        friend class NeuralNetwork;
+        
+        std::vector<int> layout;            // layer_sizes, под которые выделены буферы
+        int rows;
+        int depth;
+        
+        std::vector<cv::Mat> outputs;       // [capacity x layer_sizes[i + 1]]
+        std::vector<cv::Mat> delta_buffers;
+        std::vector<cv::Mat> activations;   // строки [0, N) буферов; [0] - сам вход
+        std::vector<cv::Mat> deltas;
+        std::vector<cv::Mat> dw, db;        // суммарные градиенты по батчу
+        double loss;
+        int correct;
+    };
+    
+    // depth - точность весов и активаций: CV_32F или CV_64F
+    NeuralNetwork(const std::vector<int>& layers, double lr = 0.1, 
+                  int depth = CV_64F, int seed = -1);
     
     // Основные методы
-    int predict(const cv::Mat& input);
+    int predict(const cv::Mat& input) const;
+    
+    // Пакетное распознавание: по изображению в строке [N x 784].
+    // Не меняет сеть, можно вызывать из нескольких потоков одновременно.
+    // probabilities (если задан) получает выход softmax [N x 10],
+    // parallel делит большой батч на части по ядрам.
+    std::vector<int> predict_batch(const cv::Mat& inputs, cv::Mat* probabilities = nullptr, 
+                                   bool parallel = false) const;
+    std::vector<int> predict_batch(const std::vector<cv::Mat>& inputs, cv::Mat* probabilities = nullptr, 
+                                   bool parallel = false) const;
+    std::vector<int> predict_batch(const Dataset& dataset, cv::Mat* probabilities = nullptr, 
+                                   bool parallel = false) const;
     double train(const std::vector<cv::Mat>& inputs, 
                  const std::vector<cv::Mat>& targets, 
                  int epochs, int batch_size = 32);
     
-    // Сохранение и загрузка модели
+    // Обучение на непрерывном наборе; shuffle - перемешивать порядок
+    // примеров (по индексам) каждую эпоху, иначе батчи - подряд идущие строки
+    double train(const Dataset& dataset, int epochs, int batch_size = 32, bool shuffle = true);
+    
+    // Обучение на батчах, которые фоновые потоки готовят заранее
+    double train(BatchPipeline& pipeline, int epochs, int batches_per_epoch);
+    
+    // Вызывается после каждой эпохи обучения (номер с 1, потери, точность);
+    // false прерывает обучение
+    typedef std::function<bool(int epoch, double loss, double accuracy)> EpochCallback;
+    void set_epoch_callback(const EpochCallback& callback);
+    
+    // Все, что нужно для точного продолжения обучения: параметры, шаг SGD,
+    // число пройденных эпох и состояние генератора перемешивания
+    struct TrainingState {
+        std::vector<int> layer_sizes;
+        double learning_rate;
+        std::vector<cv::Mat> weights, biases;
+        int epoch;
+        uint64_t steps;
+        std::string rng;
+        
+        TrainingState() : learning_rate(0.0), epoch(0), steps(0) {}
+    };
+    
+    // Снимок в state (буферы state переиспользуются - только копирование
+    // памяти). Вызывается между шагами, например из EpochCallback.
+    void capture_state(TrainingState& state) const;
+    
+    // Следующий вызов train продолжит с эпохи state.epoch + 1
+    // с тем же порядком примеров, что и непрерванное обучение
+    void restore_state(const TrainingState& state);
+    
+    // Пройдено эпох в текущем обучении
+    int get_epoch() const;
+    
+    // Глубокая копия: веса не разделяются с этой сетью
+    NeuralNetwork clone() const;
+    
+    // Копирует параметры other в собственные буферы (без выделений,
+    // если топология совпадает)
+    void copy_parameters(const NeuralNetwork& other);
+    
+    // Параллельное обучение: батч делится между потоками (не меньше
+    // MIN_SHARD_ROWS строк на поток, остальные потоки простаивают)
+    void set_num_threads(int threads);
+    int get_num_threads() const;
+    
+    int get_depth() const;
+    
+    // Доступ к параметрам (квантование, экспорт)
+    const std::vector<int>& get_layer_sizes() const;
+    const std::vector<cv::Mat>& get_weights() const;
+    const std::vector<cv::Mat>& get_biases() const;
+    
+    // Активации всех слоев для батча [N x in], включая сам вход
+    std::vector<cv::Mat> forward(const cv::Mat& input) const;
+    
+    // То же в буферы workspace; возвращает выход [N x 10], действительный
+    // до следующего вызова с этим workspace. Вход - в точности сети.
+    const cv::Mat& forward(const cv::Mat& input, Workspace& workspace) const;
+    
+    // Сохранение и загрузка модели: *.bin - бинарный формат
+    // (загружается через отображение в память), остальное - XML/YAML
     void save_model(const std::string& filename);
     void load_model(const std::string& filename);
 
@@ -24,13 +135,38 @@ private:
     std::vector<cv::Mat> weights;
     std::vector<cv::Mat> biases;
     double learning_rate;
+    int depth;
+    int num_threads;
+    
+    // Инициализация весов и перемешивание примеров
+    std::mt19937 rng;
+    
+    // Отображенный файл модели, на который ссылаются weights/biases
+    std::shared_ptr<MappedFile> model_storage;
+    
+    EpochCallback epoch_callback;
+    
+    int completed_epochs;
+    int resume_epoch;   // с какой эпохи начнет следующий train (после restore_state)
+    uint64_t steps;
+    
+    // По workspace на поток обучения
+    std::vector<Workspace> workspaces;
+    
+    // Суммы столбцов weights[0] для разреженного первого слоя;
+    // обновляются при каждом изменении весов
+    cv::Mat input_column_sums;
     
     // Вспомогательные методы
-    cv::Mat sigmoid(const cv::Mat& x);
-    cv::Mat sigmoid_derivative(const cv::Mat& x);
-    cv::Mat softmax(const cv::Mat& x);
-    std::vector<cv::Mat> forward(const cv::Mat& input);
-    void backward(const cv::Mat& input, const cv::Mat& target);
+    void update_input_sums();
+    int take_resume_epoch(int epochs);
+    void backward(const cv::Mat& target, Workspace& workspace) const;
+    void compute_gradients(const cv::Mat& input, const cv::Mat& target, Workspace& workspace) const;
+    void update(const std::vector<cv::Mat>& dw, const std::vector<cv::Mat>& db, int count);
+    void train_step(const cv::Mat& input, const cv::Mat& target, 
+                    double& loss, int& correct);
+    
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "quantized_network.h"
+#include "image_processor.h"
+#include "dataset.h"
+
+// Число обучающих примеров для калибровки масштабов
+static const int CALIBRATION_SAMPLES = 256;
+
+// Квантует сохраненную модель в INT8 и сравнивает точность с исходной.
+// Использование: digit_quantize [model.bin|model.xml] [samples]
+int main(int argc, char** argv) {
+    std::string model_path = argc > 1 ? argv[1] : "large_dataset_model.bin";
+    int samples = argc > 2 ? std::atoi(argv[2]) : 1000;
+    
+    try {
+        NeuralNetwork nn({784, 128, 64, 10}, 0.01, CV_32F);
+        nn.load_model(model_path);
+        
+        // Диапазоны активаций подбираются на обучающих данных (seed обучения),
+        // отложенная выборка с другим seed используется только для оценки
+        Dataset training = ImageProcessor::generate_dataset(CALIBRATION_SAMPLES, ImageProcessor::DEFAULT_SEED, CV_32F);
+        QuantizedNetwork qnn = QuantizedNetwork::quantize(nn, training.samples());
+        
+        Dataset dataset = ImageProcessor::generate_dataset(samples, ImageProcessor::DEFAULT_SEED + 1, CV_32F);
+        if (dataset.empty()) {
+            std::cerr << "Error: No evaluation data!" << std::endl;
+            return 1;
+        }
+        
+        const cv::Mat& batch = dataset.samples();
+        
+        std::string quantized_path = model_path;
+        size_t dot = quantized_path.rfind('.');
+        if (dot != std::string::npos) {
+            quantized_path.erase(dot);
+        }
+        quantized_path += ".int8.xml";
+        qnn.save_model(quantized_path);
+        
+        int64_t start = cv::getTickCount();
+        std::vector<int> float_pred = nn.predict_batch(batch);
+        double float_ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        
+        start = cv::getTickCount();
+        std::vector<int> int8_pred = qnn.predict_batch(batch);
+        double int8_ms = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+        
+        int float_correct = 0, int8_correct = 0, agree = 0;
+        for (size_t i = 0; i < dataset.size(); ++i) {
+            if (float_pred[i] == dataset.label(i)) float_correct++;
+            if (int8_pred[i] == dataset.label(i)) int8_correct++;
+            if (float_pred[i] == int8_pred[i]) agree++;
+        }
+        
+        size_t float_bytes = 0;
+        for (size_t i = 0; i < nn.get_weights().size(); ++i) {
+            float_bytes += nn.get_weights()[i].total() * nn.get_weights()[i].elemSize();
+            float_bytes += nn.get_biases()[i].total() * nn.get_biases()[i].elemSize();
+        }
+        
+        double n = static_cast<double>(dataset.size());
+        double float_acc = float_correct * 100.0 / n;
+        double int8_acc = int8_correct * 100.0 / n;
+        
+        std::cout << "\n=== Quantization Report ===" << std::endl;
+        std::cout << "Samples: " << dataset.size() << std::endl;
+        std::cout << "Float accuracy: " << float_acc << "% (" << float_ms << " ms)" << std::endl;
+        std::cout << "INT8 accuracy: " << int8_acc << "% (" << int8_ms << " ms)" << std::endl;
+        std::cout << "Accuracy delta: " << (int8_acc - float_acc) << "%" << std::endl;
+        std::cout << "Prediction agreement: " << (agree * 100.0 / n) << "%" << std::endl;
+        std::cout << "Model size: " << float_bytes << " -> " << qnn.model_bytes() << " bytes" << std::endl;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
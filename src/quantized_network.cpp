@@ -0,0 +1,213 @@
+#include "quantized_network.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Симметричное квантование весов: [-max, max] -> [-127, 127]
+static float symmetric_scale(double max_abs) {
+    return max_abs > 0 ? static_cast<float>(max_abs / 127.0) : 1.0f;
+}
+
+// Асимметричное квантование входов: [lo, hi] (с нулем внутри) -> [0, 255]
+static float asymmetric_scale(double lo, double hi, int& zero_point) {
+    lo = std::min(lo, 0.0);
+    hi = std::max(hi, 0.0);
+    if (hi <= lo) {
+        zero_point = 0;
+        return 1.0f;
+    }
+    
+    float scale = static_cast<float>((hi - lo) / 255.0);
+    zero_point = std::min(255, std::max(0, static_cast<int>(std::round(-lo / scale))));
+    return scale;
+}
+
+QuantizedNetwork::QuantizedNetwork() {
+}
+
+QuantizedNetwork QuantizedNetwork::quantize(const NeuralNetwork& network, const cv::Mat& calibration) {
+    QuantizedNetwork q;
+    q.layer_sizes = network.get_layer_sizes();
+    
+    const std::vector<cv::Mat>& float_weights = network.get_weights();
+    const std::vector<cv::Mat>& float_biases = network.get_biases();
+    
+    // Диапазоны входов каждого слоя по калибровочным примерам
+    cv::Mat samples;
+    calibration.convertTo(samples, network.get_depth());
+    auto activations = network.forward(samples);
+    
+    for (size_t i = 0; i < float_weights.size(); ++i) {
+        double min_in, max_in;
+        cv::minMaxLoc(activations[i], &min_in, &max_in);
+        int zero_point;
+        float input_scale = asymmetric_scale(min_in, max_in, zero_point);
+        
+        double min_w, max_w;
+        cv::minMaxLoc(float_weights[i], &min_w, &max_w);
+        float weight_scale = symmetric_scale(std::max(std::abs(min_w), std::abs(max_w)));
+        
+        cv::Mat w, b;
+        float_weights[i].convertTo(w, CV_8S, 1.0 / weight_scale);
+        float_biases[i].convertTo(b, CV_32S, 1.0 / (input_scale * weight_scale));
+        
+        // sum((x_q - zp) * w) = sum(x_q * w) - zp * sum(w): вторая часть
+        // постоянна и переносится в смещение
+        if (zero_point != 0) {
+            cv::Mat column_sums;
+            cv::reduce(w, column_sums, 0, cv::REDUCE_SUM, CV_32S);
+            b -= column_sums * zero_point;
+        }
+        
+        q.weights.push_back(w);
+        q.biases.push_back(b);
+        q.weight_scales.push_back(weight_scale);
+        q.input_scales.push_back(input_scale);
+        q.input_zero_points.push_back(zero_point);
+    }
+    
+    return q;
+}
+
+void QuantizedNetwork::quantize_input(const float* src, uchar* dst, int size, float scale, int zero_point) const {
+    float inv = 1.0f / scale;
+    for (int i = 0; i < size; ++i) {
+        float v = std::round(src[i] * inv) + zero_point;
+        dst[i] = static_cast<uchar>(std::min(255.0f, std::max(0.0f, v)));
+    }
+}
+
+void QuantizedNetwork::dense(const uchar* input, size_t layer, int* acc) const {
+    const cv::Mat& w = weights[layer];
+    const int* bias = biases[layer].ptr<int>(0);
+    std::copy(bias, bias + w.cols, acc);
+    
+    // Построчное накопление: внутренний цикл по выходам векторизуется,
+    // нулевые входы (фон, насыщенные нейроны) пропускаются
+    for (int i = 0; i < w.rows; ++i) {
+        int x = input[i];
+        if (x == 0) {
+            continue;
+        }
+        
+        const schar* row = w.ptr<schar>(i);
+        for (int j = 0; j < w.cols; ++j) {
+            acc[j] += x * row[j];
+        }
+    }
+}
+
+std::vector<int> QuantizedNetwork::predict_batch(const cv::Mat& inputs) const {
+    std::vector<int> labels(inputs.rows, -1);
+    if (inputs.empty() || weights.empty()) {
+        return labels;
+    }
+    
+    CV_Assert(inputs.cols == layer_sizes.front());
+    
+    cv::Mat samples = inputs;
+    if (samples.type() != CV_32F) {
+        inputs.convertTo(samples, CV_32F);
+    }
+    
+    int widest = *std::max_element(layer_sizes.begin(), layer_sizes.end());
+    std::vector<uchar> quantized(widest);
+    std::vector<int> acc(widest);
+    std::vector<float> activation(widest);
+    
+    for (int r = 0; r < samples.rows; ++r) {
+        const float* current = samples.ptr<float>(r);
+        
+        for (size_t layer = 0; layer < weights.size(); ++layer) {
+            int in = layer_sizes[layer];
+            int out = layer_sizes[layer + 1];
+            
+            quantize_input(current, quantized.data(), in, input_scales[layer], input_zero_points[layer]);
+            dense(quantized.data(), layer, acc.data());
+            
+            if (layer + 1 == weights.size()) {
+                // softmax монотонен - класс определяется по максимуму аккумулятора
+                labels[r] = static_cast<int>(std::max_element(acc.begin(), acc.begin() + out) - acc.begin());
+                break;
+            }
+            
+            float scale = input_scales[layer] * weight_scales[layer];
+            for (int j = 0; j < out; ++j) {
+                activation[j] = 1.0f / (1.0f + std::exp(-acc[j] * scale));
+            }
+            current = activation.data();
+        }
+    }
+    
+    return labels;
+}
+
+int QuantizedNetwork::predict(const cv::Mat& input) const {
+    try {
+        return predict_batch(input.reshape(1, 1)).front();
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Prediction error: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+size_t QuantizedNetwork::model_bytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        bytes += weights[i].total() * weights[i].elemSize();
+        bytes += biases[i].total() * biases[i].elemSize();
+    }
+    return bytes;
+}
+
+void QuantizedNetwork::save_model(const std::string& filename) const {
+    cv::FileStorage fs(filename, cv::FileStorage::WRITE);
+    
+    fs << "layer_sizes" << layer_sizes;
+    fs << "weight_scales" << weight_scales;
+    fs << "input_scales" << input_scales;
+    fs << "input_zero_points" << input_zero_points;
+    
+    for (size_t i = 0; i < weights.size(); ++i) {
+        fs << "weight_" + std::to_string(i) << weights[i];
+        fs << "bias_" + std::to_string(i) << biases[i];
+    }
+    
+    fs.release();
+    std::cout << "Quantized model saved: " << filename << std::endl;
+}
+
+void QuantizedNetwork::load_model(const std::string& filename) {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    
+    layer_sizes.clear();
+    weight_scales.clear();
+    input_scales.clear();
+    input_zero_points.clear();
+    fs["layer_sizes"] >> layer_sizes;
+    fs["weight_scales"] >> weight_scales;
+    fs["input_scales"] >> input_scales;
+    fs["input_zero_points"] >> input_zero_points;
+    
+    // Файлы с int8-входами без нулевых точек несовместимы
+    if (input_zero_points.size() != input_scales.size()) {
+        throw std::runtime_error("Quantized model " + filename + " has no input zero points, re-run digit_quantize");
+    }
+    
+    weights.clear();
+    biases.clear();
+    
+    for (size_t i = 0; i + 1 < layer_sizes.size(); ++i) {
+        cv::Mat w, b;
+        fs["weight_" + std::to_string(i)] >> w;
+        fs["bias_" + std::to_string(i)] >> b;
+        
+        weights.push_back(w);
+        biases.push_back(b);
+    }
+    
+    fs.release();
+    std::cout << "Quantized model loaded: " << filename << std::endl;
+}
@@ -0,0 +1,44 @@
+#ifndef QUANTIZED_NETWORK_H
+#define QUANTIZED_NETWORK_H
+
+#include <vector>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+
+// INT8-версия обученной NeuralNetwork для вывода на CPU.
+// Веса хранятся в int8 с масштабом на слой, входы слоев квантуются
+// в uint8 с масштабом и нулевой точкой, подобранными на калибровочных
+// примерах, скалярные произведения накапливаются в int32.
+// Входы сети ([0, 1]) и выходы сигмоиды неотрицательны, поэтому
+// нулевая точка обычно 0 и используются все 256 уровней.
+class QuantizedNetwork {
+public:
+    QuantizedNetwork();
+    
+    // calibration - примеры из обучающей выборки, по строке [N x 784]
+    static QuantizedNetwork quantize(const NeuralNetwork& network, const cv::Mat& calibration);
+    
+    int predict(const cv::Mat& input) const;
+    std::vector<int> predict_batch(const cv::Mat& inputs) const;
+    
+    // Размер весов и смещений в байтах
+    size_t model_bytes() const;
+    
+    void save_model(const std::string& filename) const;
+    void load_model(const std::string& filename);
+
+private:
+    std::vector<int> layer_sizes;
+    std::vector<cv::Mat> weights;       // CV_8S [in x out]
+    std::vector<cv::Mat> biases;        // CV_32S [1 x out], в масштабе input_scale * weight_scale,
+                                        // с поправкой -zero_point * сумма столбца весов
+    std::vector<float> weight_scales;
+    std::vector<float> input_scales;    // масштаб входа каждого слоя
+    std::vector<int> input_zero_points; // uint8-код нуля входа каждого слоя
+    
+    void quantize_input(const float* src, uchar* dst, int size, float scale, int zero_point) const;
+    void dense(const uchar* input, size_t layer, int* acc) const;
+};
+
+#endif
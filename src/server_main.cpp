@@ -0,0 +1,195 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "model_file.h"
+#include "inference_server.h"
+#include "model_snapshots.h"
+#include "metrics.h"
+
+static std::atomic<bool> stop_requested(false);
+
+static void on_signal(int) {
+    stop_requested = true;
+}
+
+// Признаки версии файла. Секундного mtime мало: две записи за одну
+// секунду неразличимы, поэтому сравниваются еще inode (атомарная замена
+// через rename дает новый), размер и mtime в наносекундах.
+struct FileStamp {
+    bool exists;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    long long mtime_ns;
+    
+    bool operator==(const FileStamp& other) const {
+        return exists == other.exists && device == other.device && inode == other.inode &&
+               size == other.size && mtime_ns == other.mtime_ns;
+    }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+static FileStamp file_stamp(const std::string& path) {
+    FileStamp stamp = FileStamp();
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return stamp;
+    }
+    
+#ifdef __APPLE__
+    const struct timespec& mtime = info.st_mtimespec;
+#else
+    const struct timespec& mtime = info.st_mtim;
+#endif
+    stamp.exists = true;
+    stamp.device = info.st_dev;
+    stamp.inode = info.st_ino;
+    stamp.size = info.st_size;
+    stamp.mtime_ns = static_cast<long long>(mtime.tv_sec) * 1000000000LL + mtime.tv_nsec;
+    return stamp;
+}
+
+// Топология сети - из заголовка файла модели, а не из констант сервера
+static std::vector<int> model_layers(const std::string& path) {
+    if (ModelFile::is_binary(path)) {
+        return ModelFile::read(path).layer_sizes;
+    }
+    
+    std::vector<int> layers;
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    fs["layer_sizes"] >> layers;
+    if (layers.size() < 2) {
+        throw std::runtime_error("No layer sizes in model file: " + path);
+    }
+    return layers;
+}
+
+static std::unique_ptr<NeuralNetwork> load_network(const std::string& path) {
+    std::unique_ptr<NeuralNetwork> network(new NeuralNetwork(model_layers(path), 0.01, CV_32F));
+    network->load_model(path);
+    return network;
+}
+
+// Перезагружает модель при изменении файла и публикует новый снимок;
+// запросы в это время обслуживаются предыдущей версией
+static void watch_model(const std::string& path, ModelSnapshots& snapshots, 
+                        const std::vector<int>& served_layers) {
+    FileStamp loaded = file_stamp(path);
+    
+    while (!stop_requested) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        FileStamp changed = file_stamp(path);
+        if (!changed.exists || changed == loaded) {
+            continue;
+        }
+        
+        try {
+            std::unique_ptr<NeuralNetwork> staging = load_network(path);
+            
+            // Клиенты рассчитывают на размер входа и число классов
+            const std::vector<int>& layers = staging->get_layer_sizes();
+            if (layers.front() != served_layers.front() || layers.back() != served_layers.back()) {
+                std::cerr << "Reload skipped: model " << path << " has " << layers.front() 
+                          << " inputs and " << layers.back() << " classes, served model has " 
+                          << served_layers.front() << " and " << served_layers.back() << std::endl;
+                loaded = changed;
+                continue;
+            }
+            
+            snapshots.publish(*staging);
+            loaded = changed;
+            std::cout << "Model reloaded: version " << snapshots.version() << std::endl;
+        } catch (const std::exception& e) {
+            // Файл может быть дописан не до конца - попробуем на следующем шаге
+            std::cerr << "Reload failed: " << e.what() << std::endl;
+        }
+    }
+}
+
+// Сервер распознавания без окна (POSIX).
+// Использование: digit_server [model.bin|model.xml] [--socket path] [--port N]
+//                             [--max-batch N] [--max-wait-us N] [--report-s N] [--watch]
+// --watch - перезагружать модель при изменении файла, без остановки сервера
+int main(int argc, char** argv) {
+    std::string model_path = "large_dataset_model.bin";
+    InferenceServer::Options options;
+    options.socket_path = "/tmp/digit_server.sock";
+    bool watch = false;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        
+        if (arg == "--socket" && has_value) {
+            options.socket_path = argv[++i];
+        } else if (arg == "--port" && has_value) {
+            options.tcp_port = std::atoi(argv[++i]);
+        } else if (arg == "--max-batch" && has_value) {
+            options.max_batch = std::atoi(argv[++i]);
+        } else if (arg == "--max-wait-us" && has_value) {
+            options.max_wait_us = std::atoi(argv[++i]);
+        } else if (arg == "--report-s" && has_value) {
+            options.report_interval_s = std::atoi(argv[++i]);
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            model_path = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    
+    try {
+        std::unique_ptr<MetricsExporter> metrics = MetricsExporter::from_env();
+        
+        std::unique_ptr<NeuralNetwork> nn = load_network(model_path);
+        
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        
+        std::cout << "Model: " << model_path 
+                  << " - Max batch: " << options.max_batch 
+                  << " - Max wait: " << options.max_wait_us << " us" << std::endl;
+        
+        ModelSnapshots snapshots(*nn);
+        std::thread watcher;
+        if (watch) {
+            watcher = std::thread(watch_model, model_path, std::ref(snapshots), nn->get_layer_sizes());
+        }
+        
+        try {
+            InferenceServer server(snapshots, options);
+            server.run(stop_requested);
+        } catch (...) {
+            stop_requested = true;
+            if (watcher.joinable()) {
+                watcher.join();
+            }
+            throw;
+        }
+        
+        stop_requested = true;
+        if (watcher.joinable()) {
+            watcher.join();
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
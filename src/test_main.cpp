@@ -0,0 +1,303 @@
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "neural_network.h"
+#include "image_processor.h"
+#include "dataset.h"
+#include "alloc_counter.h"
+#include "fixed_network.h"
+#include "model_snapshots.h"
+#include "checkpoint.h"
+#include "metrics.h"
+
+typedef FixedNetwork<784, 128, 64, 10> DigitNetwork;
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) {
+        throw std::runtime_error("Check failed: " + what);
+    }
+}
+
+// Выделения памяти за repeats вызовов fn после одного прогревочного
+static uint64_t allocations_after_warmup(const std::function<void()>& fn, int repeats = 10) {
+    fn();
+    
+    AllocationCounter::Snapshot before = AllocationCounter::snapshot();
+    for (int i = 0; i < repeats; ++i) {
+        fn();
+    }
+    return AllocationCounter::snapshot().count - before.count;
+}
+
+// Эталонный прямой проход только через cv::gemm, без разреженного первого слоя
+static cv::Mat reference_forward(const NeuralNetwork& nn, const cv::Mat& input) {
+    const std::vector<cv::Mat>& weights = nn.get_weights();
+    const std::vector<cv::Mat>& biases = nn.get_biases();
+    
+    cv::Mat a = input;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        cv::Mat z;
+        cv::gemm(a, weights[i], 1.0, cv::repeat(biases[i], a.rows, 1), 1.0, z);
+        
+        if (i + 1 < weights.size()) {
+            cv::exp(-z, z);
+            cv::add(z, cv::Scalar::all(1.0), z);
+            cv::divide(1.0, z, z);
+        } else {
+            for (int r = 0; r < z.rows; ++r) {
+                cv::Mat row = z.row(r);
+                double max_val;
+                cv::minMaxLoc(row, nullptr, &max_val);
+                cv::subtract(row, cv::Scalar(max_val), row);
+                cv::exp(row, row);
+                row /= cv::sum(row)[0];
+            }
+        }
+        a = z;
+    }
+    return a;
+}
+
+// Строки с фоном background и ~10% пикселей штриха: MNIST (фон 0)
+// и инвертированный холст интерфейса (фон 1)
+static cv::Mat sparse_rows(int rows, int depth, double background, cv::RNG& rng) {
+    cv::Mat batch(rows, 784, depth, cv::Scalar(background));
+    for (int r = 0; r < rows; ++r) {
+        for (int k = 0; k < 78; ++k) {
+            int c = rng.uniform(0, 784);
+            double value = rng.uniform(0.0, 1.0);
+            if (depth == CV_32F) {
+                batch.at<float>(r, c) = static_cast<float>(value);
+            } else {
+                batch.at<double>(r, c) = value;
+            }
+        }
+    }
+    return batch;
+}
+
+// Выход сети (разреженный первый слой) против эталона на gemm
+static void check_forward_parity(const NeuralNetwork& nn, const cv::Mat& inputs, const std::string& what) {
+    cv::Mat probabilities;
+    nn.predict_batch(inputs, &probabilities);
+    
+    double tolerance = nn.get_depth() == CV_32F ? 1e-4 : 1e-9;
+    check(cv::norm(probabilities, reference_forward(nn, inputs), cv::NORM_INF) < tolerance, what);
+}
+
+static NeuralNetwork seeded_network(double learning_rate, int depth, int seed_offset = 0) {
+    return NeuralNetwork({784, 128, 64, 10}, learning_rate, depth,
+                         static_cast<int>(ImageProcessor::DEFAULT_SEED) + seed_offset);
+}
+
+// Разреженный путь после нескольких шагов обучения (суммы столбцов
+// должны следовать за весами) на обоих видах фона
+static void test_sparse_parity(int depth) {
+    NeuralNetwork nn = seeded_network(0.32, depth);
+    nn.train(ImageProcessor::generate_dataset(128, ImageProcessor::DEFAULT_SEED, depth), 1, 32);
+    
+    cv::RNG rng(ImageProcessor::DEFAULT_SEED);
+    check_forward_parity(nn, sparse_rows(16, depth, 0.0, rng), "sparse first layer, background 0");
+    check_forward_parity(nn, sparse_rows(16, depth, 1.0, rng), "sparse first layer, background 1");
+    
+    // predict() считает одно изображение отдельно от predict_batch
+    cv::Mat single = sparse_rows(1, depth, 1.0, rng);
+    cv::Point best;
+    cv::minMaxLoc(reference_forward(nn, single), nullptr, nullptr, nullptr, &best);
+    check(nn.predict(single) == best.x, "predict, background 1");
+}
+
+// Снимки не делят буферы с обучаемой сетью: после следующих шагов
+// обучения разреженный путь снимка по-прежнему совпадает с gemm по его
+// собственным весам. Проверяются оба пути копирования: clone() при
+// создании слотов и copy_parameters() в publish().
+static void test_snapshot_isolation() {
+    NeuralNetwork nn = seeded_network(0.32, CV_32F);
+    Dataset dataset = ImageProcessor::generate_dataset(128, ImageProcessor::DEFAULT_SEED, CV_32F);
+    cv::RNG rng(ImageProcessor::DEFAULT_SEED);
+    cv::Mat canvas = sparse_rows(16, CV_32F, 1.0, rng);
+    
+    nn.train(dataset, 1, 32);
+    ModelSnapshots snapshots(nn);
+    nn.train(dataset, 1, 32);
+    check_forward_parity(*snapshots.acquire(), canvas, "cloned snapshot after further training");
+    
+    snapshots.publish(nn);
+    nn.train(dataset, 1, 32);
+    check_forward_parity(*snapshots.acquire(), canvas, "published snapshot after further training");
+}
+
+// Продолжение с контрольной точки совпадает с непрерванным обучением:
+// 2 эпохи подряд против 1 эпохи, записи точки на диск, загрузки в сеть
+// с другой инициализацией и еще 1 эпохи - вес в вес
+static void test_resume() {
+    Dataset dataset = ImageProcessor::generate_dataset(256, ImageProcessor::DEFAULT_SEED, CV_32F);
+    
+    NeuralNetwork uninterrupted = seeded_network(0.32, CV_32F);
+    uninterrupted.train(dataset, 2, 32);
+    
+    NeuralNetwork first = seeded_network(0.32, CV_32F);
+    first.train(dataset, 1, 32);
+    
+    NeuralNetwork::TrainingState saved, loaded;
+    first.capture_state(saved);
+    const std::string path = "test_checkpoint.ckpt";
+    Checkpoint::write(path, saved);
+    Checkpoint::read(path, loaded);
+    std::remove(path.c_str());
+    
+    NeuralNetwork resumed = seeded_network(0.32, CV_32F, 1);
+    resumed.restore_state(loaded);
+    resumed.train(dataset, 2, 32);
+    
+    check(resumed.get_epoch() == 2, "resumed training epoch count");
+    for (size_t i = 0; i < uninterrupted.get_weights().size(); ++i) {
+        check(cv::norm(uninterrupted.get_weights()[i], resumed.get_weights()[i], cv::NORM_INF) == 0 &&
+              cv::norm(uninterrupted.get_biases()[i], resumed.get_biases()[i], cv::NORM_INF) == 0,
+              "resumed training diverges in layer " + std::to_string(i));
+    }
+}
+
+// FixedNetwork совпадает с NeuralNetwork: вероятности с точностью
+// float, класс - кроме почти равных максимумов
+static void test_fixed_network() {
+    NeuralNetwork nn = seeded_network(0.01, CV_32F);
+    cv::Mat samples = ImageProcessor::generate_dataset(64, ImageProcessor::DEFAULT_SEED, CV_32F).samples();
+    
+    std::unique_ptr<DigitNetwork> fixed(new DigitNetwork());
+    fixed->load(nn);
+    
+    cv::Mat expected;
+    std::vector<int> labels = nn.predict_batch(samples, &expected);
+    expected.convertTo(expected, CV_32F);
+    
+    float probabilities[DigitNetwork::outputs];
+    for (int r = 0; r < samples.rows; ++r) {
+        cv::Mat row = samples.row(r);
+        fixed->forward(row.ptr<float>(), probabilities);
+        
+        const float* reference = expected.ptr<float>(r);
+        for (int c = 0; c < DigitNetwork::outputs; ++c) {
+            check(std::abs(probabilities[c] - reference[c]) < 1e-4f, "FixedNetwork probabilities");
+        }
+        
+        int label = fixed->predict(row);
+        check(label == labels[r] || std::abs(reference[label] - reference[labels[r]]) < 1e-5f,
+              "FixedNetwork label");
+    }
+}
+
+// Горячие пути распознавания не выделяют память после прогрева
+static void test_zero_allocations() {
+    NeuralNetwork nn = seeded_network(0.01, CV_32F);
+    nn.set_num_threads(cv::getNumberOfCPUs());
+    Dataset dataset = ImageProcessor::generate_dataset(256, ImageProcessor::DEFAULT_SEED, CV_32F);
+    
+    const int batch_sizes[] = {1, 32, 256};
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++i) {
+        int n = batch_sizes[i];
+        cv::Mat batch = dataset.samples().rowRange(0, n);
+        
+        NeuralNetwork::Workspace workspace;
+        check(allocations_after_warmup([&] { nn.forward(batch, workspace); }) == 0,
+              "forward_workspace allocates after warmup, batch " + std::to_string(n));
+    }
+    
+    cv::Mat single = dataset.samples().row(0);
+    check(allocations_after_warmup([&] { nn.predict(single); }) == 0, "predict allocates after warmup");
+    
+    // Рисунок на пустом фоне: первый слой идет по разреженному пути
+    cv::Mat canvas(280, 280, CV_8UC3, cv::Scalar(0, 0, 0));
+    cv::circle(canvas, cv::Point(140, 140), 80, cv::Scalar(255, 255, 255), 30);
+    cv::Mat drawn = ImageProcessor::preprocess_image(canvas, CV_32F);
+    check(allocations_after_warmup([&] { nn.predict(drawn); }) == 0, "predict_sparse allocates after warmup");
+}
+
+#ifdef DIGIT_METRICS
+// Один замер backward на слой за шаг: в одном потоке шаг - один проход
+static void test_backward_metrics() {
+    NeuralNetwork nn = seeded_network(0.32, CV_32F);
+    Dataset dataset = ImageProcessor::generate_dataset(128, ImageProcessor::DEFAULT_SEED, CV_32F);
+    size_t layers = nn.get_weights().size();
+    
+    uint64_t steps = Metrics::train_step_count();
+    std::vector<uint64_t> calls;
+    for (size_t l = 0; l < layers; ++l) {
+        calls.push_back(Metrics::layer_call_count(Metrics::BACKWARD, static_cast<int>(l)));
+    }
+    
+    nn.train(dataset, 1, 32);
+    
+    steps = Metrics::train_step_count() - steps;
+    check(steps == 4, "train steps per epoch");
+    for (size_t l = 0; l < layers; ++l) {
+        uint64_t passes = Metrics::layer_call_count(Metrics::BACKWARD, static_cast<int>(l)) - calls[l];
+        check(passes == steps, "backward passes in layer " + std::to_string(l));
+    }
+}
+#endif
+
+// Проверки корректности быстрых путей сети.
+// Использование: digit_tests [имя теста] - без аргумента выполняются все.
+// Код возврата 1, если хотя бы одна проверка не прошла.
+int main(int argc, char** argv) {
+    AllocationCounter::install();
+    
+    struct Test {
+        const char* name;
+        std::function<void()> run;
+    };
+    const Test tests[] = {
+        {"sparse_parity_32f", [] { test_sparse_parity(CV_32F); }},
+        {"sparse_parity_64f", [] { test_sparse_parity(CV_64F); }},
+        {"snapshot_isolation", test_snapshot_isolation},
+        {"resume", test_resume},
+        {"fixed_network", test_fixed_network},
+        {"zero_allocations", test_zero_allocations},
+#ifdef DIGIT_METRICS
+        {"backward_metrics", test_backward_metrics},
+#endif
+    };
+    
+    std::string only = argc > 1 ? argv[1] : "";
+    int run = 0, failed = 0;
+    
+    for (const Test& test : tests) {
+        if (!only.empty() && only != test.name) {
+            continue;
+        }
+        
+        // Обучение и генерация печатают прогресс - в отчете только итоги
+        std::ostringstream silenced;
+        std::streambuf* console = std::cout.rdbuf(silenced.rdbuf());
+        std::string error;
+        try {
+            test.run();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        std::cout.rdbuf(console);
+        
+        run++;
+        if (error.empty()) {
+            std::cout << "[ OK ] " << test.name << std::endl;
+        } else {
+            failed++;
+            std::cout << "[FAIL] " << test.name << ": " << error << std::endl;
+        }
+    }
+    
+    if (run == 0) {
+        std::cerr << "Unknown test: " << only << std::endl;
+        return 1;
+    }
+    
+    std::cout << run - failed << "/" << run << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}